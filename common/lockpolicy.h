@@ -0,0 +1,298 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   锁策略(lock policy)
+*
+*           spinlockvsmutex1 / spinlockvsmutex2 的消费者/工作线程
+*           以模板参数的方式使用锁, 每个策略在编译期实例化并完全内联,
+*           同一个程序内可依次运行所有策略, 不再需要 -DUSE_SPINLOCK 编译两次.
+*
+*           每个策略提供:
+*               static const char *name();
+*               void init();
+*               void destroy();
+*               void lock();
+*               void unlock();
+*
+*           pthread_spin / pthread_mutex / adaptive_mutex / ticket / mcs
+*           spin_yield / spin_park (线程数多于核数时使用)
+**********************************************************/
+
+#ifndef LOCKPOLICY_H
+#define LOCKPOLICY_H
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <atomic>
+
+#define LOCK_INLINE inline __attribute__((always_inline))
+
+//--缓存行大小
+#define CACHE_LINE_SIZE 64
+
+//--spin-then-yield / spin-then-park 让出 CPU 之前的自旋次数
+#define SPIN_TRIES 128
+
+/*!
+ * \brief 自旋等待提示, 降低自旋时对流水线和超线程兄弟核的影响
+ */
+static LOCK_INLINE void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+/*!
+ * \brief pthread 自旋锁
+ */
+struct PthreadSpinLock
+{
+    static const char *name() { return "pthread_spin"; }
+
+    void init() { pthread_spin_init(&m_spin, PTHREAD_PROCESS_PRIVATE); }
+    void destroy() { pthread_spin_destroy(&m_spin); }
+
+    LOCK_INLINE void lock() { pthread_spin_lock(&m_spin); }
+    LOCK_INLINE void unlock() { pthread_spin_unlock(&m_spin); }
+
+    pthread_spinlock_t m_spin;
+};
+
+/*!
+ * \brief pthread 互斥量(默认属性, 竞争时直接进入内核休眠)
+ */
+struct PthreadMutex
+{
+    static const char *name() { return "pthread_mutex"; }
+
+    void init() { pthread_mutex_init(&m_mutex, NULL); }
+    void destroy() { pthread_mutex_destroy(&m_mutex); }
+
+    LOCK_INLINE void lock() { pthread_mutex_lock(&m_mutex); }
+    LOCK_INLINE void unlock() { pthread_mutex_unlock(&m_mutex); }
+
+    pthread_mutex_t m_mutex;
+};
+
+/*!
+ * \brief 自适应互斥量(glibc PTHREAD_MUTEX_ADAPTIVE_NP)
+ *        竞争时先在用户态自旋一段时间, 仍拿不到锁再休眠
+ *        非 glibc 平台退化为默认互斥量
+ */
+struct PthreadAdaptiveMutex
+{
+    static const char *name() { return "adaptive_mutex"; }
+
+    void init()
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+#endif
+        pthread_mutex_init(&m_mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+    void destroy() { pthread_mutex_destroy(&m_mutex); }
+
+    LOCK_INLINE void lock() { pthread_mutex_lock(&m_mutex); }
+    LOCK_INLINE void unlock() { pthread_mutex_unlock(&m_mutex); }
+
+    pthread_mutex_t m_mutex;
+};
+
+/*!
+ * \brief 排队自旋锁(ticket lock)
+ *        按取号顺序获得锁, 严格先来先服务(FIFO)
+ *        取号和叫号分别放在不同缓存行, 避免取号时干扰持锁者
+ */
+struct TicketLock
+{
+    static const char *name() { return "ticket"; }
+
+    void init()
+    {
+        m_next.store(0, std::memory_order_relaxed);
+        m_serving.store(0, std::memory_order_relaxed);
+    }
+    void destroy() {}
+
+    LOCK_INLINE void lock()
+    {
+        //--取号
+        unsigned ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+
+        //--等待叫号
+        while (m_serving.load(std::memory_order_acquire) != ticket)
+            cpu_relax();
+    }
+
+    LOCK_INLINE void unlock()
+    {
+        //--只有持锁者修改 m_serving, 不需要原子加
+        unsigned serving = m_serving.load(std::memory_order_relaxed);
+        m_serving.store(serving + 1, std::memory_order_release);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<unsigned> m_next;
+    alignas(CACHE_LINE_SIZE) std::atomic<unsigned> m_serving;
+};
+
+/*!
+ * \brief MCS 队列锁
+ *        每个等待者在自己的节点上自旋, 释放锁时只唤醒后继节点,
+ *        竞争激烈时缓存行不会在所有核之间来回传递
+ *
+ *        节点放在线程局部存储中: 本程序中一个线程同一时刻只持有一把锁
+ */
+struct McsLock
+{
+    struct Node
+    {
+        std::atomic<Node *> next;
+        std::atomic<bool> locked;
+    } __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    static const char *name() { return "mcs"; }
+
+    void init() { m_tail.store(NULL, std::memory_order_relaxed); }
+    void destroy() {}
+
+    LOCK_INLINE void lock()
+    {
+        Node *node = &s_node;
+        node->next.store(NULL, std::memory_order_relaxed);
+        node->locked.store(true, std::memory_order_relaxed);
+
+        //--加入队尾
+        Node *prev = m_tail.exchange(node, std::memory_order_acq_rel);
+        if (prev == NULL)
+            return;
+
+        //--链接到前驱, 在自己的节点上自旋
+        prev->next.store(node, std::memory_order_release);
+        while (node->locked.load(std::memory_order_acquire))
+            cpu_relax();
+    }
+
+    LOCK_INLINE void unlock()
+    {
+        Node *node = &s_node;
+        Node *succ = node->next.load(std::memory_order_acquire);
+
+        if (succ == NULL) {
+            //--没有后继, 尝试把队尾置空
+            Node *expected = node;
+            if (m_tail.compare_exchange_strong(expected, NULL,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed))
+                return;
+
+            //--有新的等待者正在链接, 等待其完成
+            while ((succ = node->next.load(std::memory_order_acquire)) == NULL)
+                cpu_relax();
+        }
+
+        //--把锁交给后继
+        succ->locked.store(false, std::memory_order_release);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<Node *> m_tail;
+    static inline thread_local Node s_node;
+};
+
+/*!
+ * \brief 先自旋, 自旋 SPIN_TRIES 次仍拿不到锁则 sched_yield() 让出 CPU
+ *        线程数多于核数时, 持锁线程被抢占后等待者不会整个时间片空转
+ */
+struct SpinYieldLock
+{
+    static const char *name() { return "spin_yield"; }
+
+    void init() { m_locked.store(0, std::memory_order_relaxed); }
+    void destroy() {}
+
+    LOCK_INLINE void lock()
+    {
+        int tries = 0;
+
+        while (1) {
+            //--先读后写(test-and-test-and-set), 自旋时不抢占缓存行
+            if (m_locked.load(std::memory_order_relaxed) == 0
+                    && m_locked.exchange(1, std::memory_order_acquire) == 0)
+                return;
+
+            if (++tries < SPIN_TRIES) {
+                cpu_relax();
+            } else {
+                tries = 0;
+                sched_yield();
+            }
+        }
+    }
+
+    LOCK_INLINE void unlock() { m_locked.store(0, std::memory_order_release); }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int> m_locked;
+};
+
+/*!
+ * \brief 先自旋, 自旋 SPIN_TRIES 次仍拿不到锁则在 futex 上休眠
+ *        状态: 0 未加锁, 1 加锁无等待者, 2 加锁且可能有等待者
+ *        (Ulrich Drepper, "Futexes Are Tricky", mutex3)
+ */
+struct SpinParkLock
+{
+    static const char *name() { return "spin_park"; }
+
+    void init() { m_state.store(0, std::memory_order_relaxed); }
+    void destroy() {}
+
+    LOCK_INLINE void lock()
+    {
+        int c, tries;
+
+        //--自旋阶段
+        for (tries = 0; tries < SPIN_TRIES; tries++) {
+            c = 0;
+            if (m_state.load(std::memory_order_relaxed) == 0
+                    && m_state.compare_exchange_strong(c, 1, std::memory_order_acquire,
+                                                       std::memory_order_relaxed))
+                return;
+            cpu_relax();
+        }
+
+        //--休眠阶段: 标记有等待者, 锁仍被占用则在 futex 上等待
+        c = m_state.exchange(2, std::memory_order_acquire);
+        while (c != 0) {
+            futex(FUTEX_WAIT_PRIVATE, 2);
+            c = m_state.exchange(2, std::memory_order_acquire);
+        }
+    }
+
+    LOCK_INLINE void unlock()
+    {
+        //--状态为 2 时可能有线程在 futex 上休眠, 唤醒一个
+        if (m_state.fetch_sub(1, std::memory_order_release) != 1) {
+            m_state.store(0, std::memory_order_release);
+            futex(FUTEX_WAKE_PRIVATE, 1);
+        }
+    }
+
+    void futex(int op, int val)
+    {
+        syscall(SYS_futex, reinterpret_cast<int *>(&m_state), op, val, NULL, NULL, 0);
+    }
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int> m_state;
+};
+
+#endif // LOCKPOLICY_H
@@ -0,0 +1,11 @@
+# 命令行批量渲染, 不链接 QtWidgets
+QT = core gui
+
+TARGET = mandelbrot-batch
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../engine.pri)
+
+SOURCES += main.cpp
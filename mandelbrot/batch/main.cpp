@@ -0,0 +1,322 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   命令行批量渲染, 不需要图形界面
+*
+*           直接驱动 RenderThread, 每帧等最后一轮完成(renderFinished)后
+*           写出 PPM / PNG 并打印耗时和 Mpixel/s.
+*           --frames N 渲染缩放/平移序列, 每帧相对上一帧乘 --zoom、移动 --pan 像素:
+*               纯平移时复用迭代状态缓冲区, 中心不变的深度缩放复用参考轨道,
+*               --tile-cache 时经过同一量化缩放的分块从缓存取得.
+*
+*           --fractal 选择 julia / multibrot / burning-ship(见 fractalkernel.h), 中心和缩放不随之改变.
+*
+*           mandelbrot-batch --center-x -0.743643887037158704752191506114774
+*                            --center-y 0.131825904205311970493132056385139
+*                            --scale 1e-3 --frames 60 --zoom 0.5 --output zoom.png
+**********************************************************/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QStringList>
+
+#include <stdio.h>
+
+#include "renderthread.h"
+
+/*!
+ * \brief 写出二进制 PPM(P6), 不依赖图像格式插件
+ */
+static bool savePpm(const QImage &image, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QByteArray header = QByteArray("P6\n") + QByteArray::number(image.width()) + ' '
+            + QByteArray::number(image.height()) + "\n255\n";
+    if (file.write(header) != header.size())
+        return false;
+
+    //--Format_RGB32 每像素 0xffrrggbb, 逐行转换为 RGB 三字节
+    QByteArray line(image.width() * 3, 0);
+    for (int y = 0; y < image.height(); ++y) {
+        const QRgb *pixels = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+        char *rgb = line.data();
+        for (int x = 0; x < image.width(); ++x) {
+            *rgb++ = char(qRed(pixels[x]));
+            *rgb++ = char(qGreen(pixels[x]));
+            *rgb++ = char(qBlue(pixels[x]));
+        }
+        if (file.write(line) != line.size())
+            return false;
+    }
+    return true;
+}
+
+/*!
+ * \brief 序列的第 frame 帧文件名: 扩展名前插入 4 位帧号, 单帧时不变
+ */
+static QString frameFileName(const QString &output, int frame, int frames)
+{
+    if (frames == 1)
+        return output;
+
+    int dot = output.lastIndexOf('.');
+    if (dot < 0)
+        dot = output.size();
+    return output.left(dot) + QString::asprintf("-%04d", frame) + output.mid(dot);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mandelbrot-batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Renders the Mandelbrot set without a GUI.");
+    parser.addHelpOption();
+
+    QCommandLineOption centerXOption("center-x", "Real part of the center (decimal, any precision).",
+                                     "x", "-0.637011");
+    QCommandLineOption centerYOption("center-y", "Imaginary part of the center (decimal, any precision).",
+                                     "y", "-0.0395159");
+    QCommandLineOption scaleOption("scale", "Distance between adjacent pixels.", "scale", "0.00403897");
+    QCommandLineOption sizeOption("size", "Image size.", "WxH", "800x600");
+    QCommandLineOption maxIterationsOption("max-iterations", "Iteration limit of the last pass.", "n",
+                                           QString::number(int(RenderThread::DefaultMaxIterations)));
+    QCommandLineOption threadsOption("threads", "Render threads (default: CPU cores).", "n",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption outputOption("output", "Output file, .ppm or any format QImage writes (.png).",
+                                    "file", "mandelbrot.png");
+    QCommandLineOption framesOption("frames", "Number of frames of the zoom sequence.", "n", "1");
+    QCommandLineOption zoomOption("zoom", "Scale factor between consecutive frames.", "factor", "0.8");
+    QCommandLineOption panOption("pan", "Center movement per frame in pixels.", "dx,dy", "0,0");
+    QCommandLineOption noInteriorOption("no-interior-checks", "Disable cardioid/bulb and periodicity checks.");
+    QCommandLineOption marianiSilverOption("mariani-silver", "Use Mariani-Silver subdivision.");
+    QCommandLineOption tileCacheOption("tile-cache", "Use the tile cache.");
+    QCommandLineOption deepZoomOption("deep-zoom", "Force perturbation rendering.");
+    QCommandLineOption adaptiveOption("adaptive", "Adaptive per-pass iteration limits; stop early once passes change few pixels.");
+    QCommandLineOption symmetryOption("symmetry", "Mirror rows across the real axis when the view straddles it.");
+    QCommandLineOption frameBudgetOption("frame-budget", "Publish partial results every N ms and resume in the next slice (0: off).",
+                                         "ms", "0");
+    QCommandLineOption fractalOption("fractal", "Fractal: mandelbrot, julia, multibrot or burning-ship.",
+                                     "name", "mandelbrot");
+    QCommandLineOption exponentOption("exponent", "Multibrot exponent, 3 to 8.", "d", "3");
+    QCommandLineOption juliaOption("julia", "Julia set constant K, |K| <= 2.", "x,y", "-0.8,0.156");
+    QCommandLineOption paletteOption("palette", "Palette: spectrum, fire, ocean or grayscale.", "name", "spectrum");
+    QCommandLineOption smoothOption("smooth", "Smooth (fractional iteration) coloring.");
+    QCommandLineOption equalizeOption("equalize", "Histogram-equalized coloring.");
+
+    parser.addOption(centerXOption);
+    parser.addOption(centerYOption);
+    parser.addOption(scaleOption);
+    parser.addOption(sizeOption);
+    parser.addOption(maxIterationsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(outputOption);
+    parser.addOption(framesOption);
+    parser.addOption(zoomOption);
+    parser.addOption(panOption);
+    parser.addOption(noInteriorOption);
+    parser.addOption(marianiSilverOption);
+    parser.addOption(tileCacheOption);
+    parser.addOption(deepZoomOption);
+    parser.addOption(adaptiveOption);
+    parser.addOption(symmetryOption);
+    parser.addOption(frameBudgetOption);
+    parser.addOption(fractalOption);
+    parser.addOption(exponentOption);
+    parser.addOption(juliaOption);
+    parser.addOption(paletteOption);
+    parser.addOption(smoothOption);
+    parser.addOption(equalizeOption);
+    parser.process(app);
+
+    //--参数检查, 任一项错误时退出
+    bool centerXOk = false;
+    bool centerYOk = false;
+    bool scaleOk = false;
+    bool zoomOk = false;
+    bool maxIterationsOk = false;
+    bool threadsOk = false;
+    bool framesOk = false;
+    bool frameBudgetOk = false;
+    bool widthOk = false;
+    bool heightOk = false;
+    bool panXOk = false;
+    bool panYOk = false;
+    bool exponentOk = false;
+    bool juliaXOk = false;
+    bool juliaYOk = false;
+
+    MpFloat centerX = MpFloat::fromString(parser.value(centerXOption).toLatin1().constData(), &centerXOk);
+    MpFloat centerY = MpFloat::fromString(parser.value(centerYOption).toLatin1().constData(), &centerYOk);
+    double scale = parser.value(scaleOption).toDouble(&scaleOk);
+    double zoom = parser.value(zoomOption).toDouble(&zoomOk);
+    int maxIterations = parser.value(maxIterationsOption).toInt(&maxIterationsOk);
+    int threads = parser.value(threadsOption).toInt(&threadsOk);
+    int frames = parser.value(framesOption).toInt(&framesOk);
+    int frameBudget = parser.value(frameBudgetOption).toInt(&frameBudgetOk);
+
+    QStringList size = parser.value(sizeOption).split('x');
+    int width = size.value(0).toInt(&widthOk);
+    int height = size.value(1).toInt(&heightOk);
+
+    QStringList pan = parser.value(panOption).split(',');
+    int panX = pan.value(0).toInt(&panXOk);
+    int panY = pan.value(1).toInt(&panYOk);
+
+    Fractal fractal;
+    fractal.exponent = parser.value(exponentOption).toInt(&exponentOk);
+    QStringList julia = parser.value(juliaOption).split(',');
+    fractal.juliaX = julia.value(0).toDouble(&juliaXOk);
+    fractal.juliaY = julia.value(1).toDouble(&juliaYOk);
+
+    if (!centerXOk || !centerYOk) {
+        fprintf(stderr, "invalid center\n");
+        return 1;
+    }
+    if (!scaleOk || scale <= 0 || !zoomOk || zoom <= 0) {
+        fprintf(stderr, "invalid scale or zoom factor\n");
+        return 1;
+    }
+    if (size.size() != 2 || !widthOk || !heightOk || width < 2 || height < 2) {
+        fprintf(stderr, "invalid size, expected WxH\n");
+        return 1;
+    }
+    if (pan.size() != 2 || !panXOk || !panYOk) {
+        fprintf(stderr, "invalid pan, expected dx,dy\n");
+        return 1;
+    }
+    if (!maxIterationsOk || maxIterations < 1 || !threadsOk || threads < 1 || !framesOk || frames < 1) {
+        fprintf(stderr, "max-iterations, threads and frames must be positive\n");
+        return 1;
+    }
+
+    if (!frameBudgetOk || frameBudget < 0) {
+        fprintf(stderr, "invalid frame budget\n");
+        return 1;
+    }
+
+    int family = fractalFamilyFromName(parser.value(fractalOption).toLatin1().constData());
+    if (family < 0) {
+        fprintf(stderr, "unknown fractal\n");
+        return 1;
+    }
+    fractal.family = FractalFamily(family);
+    if (!exponentOk || fractal.exponent < MinMultibrotExponent || fractal.exponent > MaxMultibrotExponent) {
+        fprintf(stderr, "invalid exponent, expected 3 to 8\n");
+        return 1;
+    }
+    if (julia.size() != 2 || !juliaXOk || !juliaYOk
+            || (fractal.juliaX * fractal.juliaX) + (fractal.juliaY * fractal.juliaY) > 4) {
+        fprintf(stderr, "invalid Julia constant, expected x,y with |K| <= 2\n");
+        return 1;
+    }
+
+    int palette = 0;
+    while (palette < PaletteCount && parser.value(paletteOption) != paletteName(Palette(palette)))
+        ++palette;
+    if (palette == PaletteCount) {
+        fprintf(stderr, "unknown palette\n");
+        return 1;
+    }
+
+    int colorOptions = 0;
+    if (parser.isSet(smoothOption))
+        colorOptions |= ColorSmooth;
+    if (parser.isSet(equalizeOption))
+        colorOptions |= ColorEqualize;
+
+    int options = RenderThread::InteriorChecks;
+    if (parser.isSet(noInteriorOption))
+        options &= ~RenderThread::InteriorChecks;
+    if (parser.isSet(marianiSilverOption))
+        options |= RenderThread::MarianiSilver;
+    if (parser.isSet(tileCacheOption))
+        options |= RenderThread::TileCaching;
+    if (parser.isSet(deepZoomOption))
+        options |= RenderThread::DeepZoom;
+    if (parser.isSet(adaptiveOption))
+        options |= RenderThread::AdaptiveIterations;
+    if (parser.isSet(symmetryOption))
+        options |= RenderThread::ConjugateSymmetry;
+
+    RenderThread thread;
+    thread.setOptions(options);
+    thread.setMaxIterations(maxIterations);
+    thread.setThreadCount(threads);
+    thread.setFrameBudget(frameBudget, threads);
+    thread.setFractal(fractal);
+    thread.setPalette(Palette(palette));
+    thread.setColorOptions(colorOptions);
+
+    QString output = parser.value(outputOption);
+    QSize resultSize(width, height);
+    int frame = 0;
+    qint64 totalNs = 0;
+    qint64 totalPixels = 0;
+
+    //--从 render() 到最后一轮完成的墙钟时间
+    QElapsedTimer timer;
+
+    //--每帧完成后写出、打印, 再请求下一帧; renderFinished 在本线程(事件循环)中处理,
+    //--最后一轮已发布到帧环, 取出的帧在下一次 acquire() 之前不会被渲染线程改写
+    QObject::connect(&thread, &RenderThread::renderFinished, &app, [&]() {
+        qint64 ns = timer.nsecsElapsed();
+        RenderThread::Statistics stats = thread.statistics();
+        const FrameRing::Frame *last = thread.frameRing()->acquire();
+        const QImage &image = last->image;
+        double scaleFactor = last->scaleFactor;
+
+        QString fileName = frameFileName(output, frame, frames);
+        bool saved = fileName.endsWith(".ppm", Qt::CaseInsensitive)
+                ? savePpm(image, fileName) : image.save(fileName);
+        if (!saved) {
+            fprintf(stderr, "cannot write %s\n", qPrintable(fileName));
+            app.exit(1);
+            return;
+        }
+
+        double seconds = ns * 1e-9;
+        printf("frame %d: scale %.6g, %dx%d, kernel %s/%s, %d passes (max %d), %.1f ms, "
+               "%.2f Mpixel/s, %lld iterations (%lld saved), %d references, cache %lld hits / %lld misses\n",
+               frame, scaleFactor, image.width(), image.height(),
+               kernelIsaName(stats.isa), precisionName(stats.precision),
+               stats.passes, stats.maxIterations, ns * 1e-6,
+               stats.pixels / seconds * 1e-6, stats.iterations, stats.savedIterations, stats.references,
+               stats.cacheHits, stats.cacheMisses);
+        if (frameBudget > 0)
+            printf("  frame budget %d ms: %d deadline frames, interval %lld us (jitter %lld us, max %lld us), "
+                   "CPU %d%%\n", frameBudget, stats.budgetFrames, stats.frameIntervalUs, stats.frameJitterUs,
+                   stats.maxFrameIntervalUs, stats.cpuPercent);
+        fflush(stdout);
+
+        totalNs += ns;
+        totalPixels += stats.pixels;
+
+        if (++frame == frames) {
+            printf("%d frames: %.1f ms, %.2f Mpixel/s\n",
+                   frames, totalNs * 1e-6, totalPixels / (totalNs * 1e-9) * 1e-6);
+            app.exit(0);
+            return;
+        }
+
+        //--下一帧: 先按当前缩放平移(像素, x 向右 y 向下), 再缩放
+        centerX += MpFloat(panX * scale);
+        centerY += MpFloat(panY * scale);
+        scale *= zoom;
+
+        timer.start();
+        thread.render(centerX, centerY, scale, resultSize);
+    });
+
+    timer.start();
+    thread.render(centerX, centerY, scale, resultSize);
+
+    return app.exec();
+}
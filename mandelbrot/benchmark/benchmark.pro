@@ -0,0 +1,18 @@
+# 逃逸时间内核基准测试, 不链接 QtWidgets
+QT = core gui
+
+TARGET = mandelbrot-benchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../engine.pri)
+
+SOURCES += main.cpp
+
+# 参考视图的迭代次数(golden), --golden-dir 可另行指定
+DEFINES += MANDELBROT_GOLDEN_DIR=\\\"$$PWD/golden\\\"
+DISTFILES += golden/default.golden \
+             golden/interior.golden \
+             golden/boundary.golden \
+             golden/deep.golden
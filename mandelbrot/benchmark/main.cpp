@@ -0,0 +1,447 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   逃逸时间内核基准测试
+*
+*           固定的参考视图(界面默认视图 / 内部点为主 / 边界密集 / 深度缩放),
+*           按 指令集 x 精度 x 线程数 逐一渲染, 每种组合重复若干次取最快一次,
+*           记录每轮完成的时间、迭代次数/秒、像素/秒, 结果写成 JSON.
+*           每个视图按比例缩小到 GoldenWidth x GoldenHeight, 与保存的迭代次数(golden)逐像素比较:
+*               double 内核各指令集必须逐位一致, 其余精度允许 MaxMismatchRatio 的像素不同.
+*           --update-golden 用标量 double(深度缩放为定点数)内核重新生成 golden.
+*
+*           mandelbrot-benchmark --threads 1,4 --output benchmark.json
+**********************************************************/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QSysInfo>
+
+#include <stdio.h>
+
+#include "renderthread.h"
+
+#ifndef MANDELBROT_GOLDEN_DIR
+#define MANDELBROT_GOLDEN_DIR "golden"
+#endif
+
+/*!
+ * \brief 参考视图, 中心用十进制字符串给出(深度缩放超出 double 的有效位)
+ */
+struct BenchmarkView
+{
+    const char *name;
+    const char *centerX;
+    const char *centerY;
+    double scaleFactor;
+    int width;
+    int height;
+    int maxIterations;
+    unsigned precisions;            //--要测的精度, 1 << KernelPrecision
+    KernelPrecision goldenPrecision;
+};
+
+#define PRECISION_BIT(precision) (1u << (precision))
+
+static const BenchmarkView Views[] = {
+    //--界面默认视图: MandelbrotWidget 的 DefaultCenterX/Y/Scale(float 常量)的精确值
+    { "default", "-0.637010991573333740234375", "-0.0395159013569355010986328125",
+      0.004038969986140727996826171875, 640, 480, 4128,
+      PRECISION_BIT(PrecisionFloat) | PRECISION_BIT(PrecisionDouble), PrecisionDouble },
+
+    //--大部分像素在主心形内, 不做内部点判定时每个都迭代到上限
+    { "interior", "-0.25", "0", 0.0015, 640, 480, 4128,
+      PRECISION_BIT(PrecisionFloat) | PRECISION_BIT(PrecisionDouble), PrecisionDouble },
+
+    //--海马谷: 边界密集, 迭代次数分布宽, 相邻像素差别大
+    { "boundary", "-0.7453", "0.1127", 1e-5, 640, 480, 16416,
+      PRECISION_BIT(PrecisionDouble), PrecisionDouble },
+
+    //--深度缩放: 只有 double-double / 定点数 / 微扰的精度足够
+    { "deep", "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139",
+      1e-20, 128, 96, 16416,
+      PRECISION_BIT(PrecisionDoubleDouble) | PRECISION_BIT(PrecisionFixed128)
+      | PRECISION_BIT(PrecisionPerturbation), PrecisionFixed128 },
+};
+
+/// \brief golden 的图像大小: 覆盖整个视图, 像素间距放大 width / GoldenWidth 倍
+///        (只取视图中央一块时, interior 视图全在主心形内, 比较不出任何差别)
+static const int GoldenWidth = 128;
+static const int GoldenHeight = 96;
+
+/// \brief golden 文件魔数 "MBGL"
+static const quint32 GoldenMagic = 0x4d42474c;
+
+/// \brief double 以外的精度与 golden 不同的像素比例上限(舍入不同, 边界像素的迭代次数会变)
+static const double MaxMismatchRatio = 0.01;
+
+/*!
+ * \brief 一次渲染的结果
+ */
+struct RenderResult
+{
+    KernelIsa isa;
+    KernelPrecision precision;
+    double ms;                          //--render() 到最后一轮完成
+    QVector<int> passMaxIterations;
+    QVector<double> passMs;             //--render() 到每轮完成
+    RenderThread::Statistics stats;
+    QVector<int> iterationMap;
+};
+
+/*!
+ * \brief 用指定的内核渲染一帧, 等待最后一轮完成
+ *        指令集和精度通过 RenderThread 支持的环境变量 MANDELBROT_KERNEL / MANDELBROT_PRECISION 指定,
+ *        每次新建 RenderThread, 不复用上一次的迭代状态和参考轨道
+ */
+static RenderResult renderView(const BenchmarkView &view, double scaleFactor, QSize size, KernelIsa isa,
+                               KernelPrecision precision, int threads, int options, bool keepMap)
+{
+    qputenv("MANDELBROT_KERNEL", kernelIsaName(isa));
+    qputenv("MANDELBROT_PRECISION", precisionName(precision));
+
+    RenderResult result;
+    QElapsedTimer timer;
+    QEventLoop loop;
+
+    RenderThread thread;
+    thread.setOptions(options);
+    thread.setMaxIterations(view.maxIterations);
+    thread.setThreadCount(threads);
+
+    //--每轮完成时在渲染线程中直接记录(此时下一轮尚未开始), 最后一轮完成后回到本线程退出事件循环
+    QObject::connect(&thread, &RenderThread::frameReady, [&]() {
+        result.passMaxIterations.append(thread.statistics().maxIterations);
+        result.passMs.append(timer.nsecsElapsed() * 1e-6);
+    });
+    QObject::connect(&thread, &RenderThread::renderFinished, &loop, &QEventLoop::quit);
+
+    timer.start();
+    thread.render(MpFloat::fromString(view.centerX), MpFloat::fromString(view.centerY),
+                  scaleFactor, size);
+    loop.exec();
+
+    result.stats = thread.statistics();
+    result.isa = result.stats.isa;
+    result.precision = result.stats.precision;
+    result.ms = result.passMs.isEmpty() ? 0 : result.passMs.last();
+    if (keepMap)
+        result.iterationMap = thread.iterationMap();
+
+    qunsetenv("MANDELBROT_KERNEL");
+    qunsetenv("MANDELBROT_PRECISION");
+    return result;
+}
+
+static QString goldenFileName(const QString &directory, const BenchmarkView &view)
+{
+    return directory + '/' + view.name + ".golden";
+}
+
+/*!
+ * \brief golden 文件: QDataStream(大端) 魔数, 宽, 高, 最大迭代次数,
+ *        再是 qCompress 压缩的每像素迭代次数(qint32 大端, 未逃逸为 -1)
+ */
+static bool loadGolden(const QString &fileName, const BenchmarkView &view, QVector<int> *map)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint32 maxIterations = 0;
+    QByteArray compressed;
+    in >> magic >> width >> height >> maxIterations >> compressed;
+    if (in.status() != QDataStream::Ok || magic != GoldenMagic || width != GoldenWidth
+            || height != GoldenHeight || maxIterations != view.maxIterations)
+        return false;
+
+    QByteArray data = qUncompress(compressed);
+    if (data.size() != width * height * int(sizeof(qint32)))
+        return false;
+
+    QDataStream pixels(data);
+    map->resize(width * height);
+    for (int i = 0; i < map->size(); ++i) {
+        qint32 value;
+        pixels >> value;
+        (*map)[i] = value;
+    }
+    return true;
+}
+
+static bool saveGolden(const QString &fileName, const BenchmarkView &view, const QVector<int> &map)
+{
+    QByteArray data;
+    QDataStream pixels(&data, QIODevice::WriteOnly);
+    for (int value : map)
+        pixels << qint32(value);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream out(&file);
+    out << GoldenMagic << qint32(GoldenWidth) << qint32(GoldenHeight) << qint32(view.maxIterations)
+        << qCompress(data, 9);
+    return out.status() == QDataStream::Ok;
+}
+
+/*!
+ * \brief 逐像素与 golden 比较: 不同的像素数, 两边都逃逸的像素迭代次数的最大差
+ */
+static QJsonObject compareGolden(const QVector<int> &map, const QVector<int> &golden,
+                                 KernelPrecision precision, bool *passed)
+{
+    int mismatches = 0;
+    int maxDifference = 0;
+    for (int i = 0; i < map.size(); ++i) {
+        if (map[i] == golden[i])
+            continue;
+        ++mismatches;
+        if (map[i] >= 0 && golden[i] >= 0)
+            maxDifference = qMax(maxDifference, qAbs(map[i] - golden[i]));
+    }
+
+    int allowed = precision == PrecisionDouble ? 0 : int(MaxMismatchRatio * map.size());
+    *passed = mismatches <= allowed;
+
+    QJsonObject object;
+    object["mismatches"] = mismatches;
+    object["allowedMismatches"] = allowed;
+    object["maxDifference"] = maxDifference;
+    object["passed"] = *passed;
+    return object;
+}
+
+/*!
+ * \brief 逗号分隔的正整数列表
+ */
+static QVector<int> parseList(const QString &text, bool *ok)
+{
+    QVector<int> values;
+    *ok = true;
+    for (const QString &item : text.split(',')) {
+        int value = item.toInt(ok);
+        if (!*ok || value < 1) {
+            *ok = false;
+            return QVector<int>();
+        }
+        if (!values.contains(value))
+            values.append(value);
+    }
+    return values;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mandelbrot-benchmark");
+
+    QStringList viewNames;
+    for (const BenchmarkView &view : Views)
+        viewNames << view.name;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the escape-time kernels on fixed reference views.");
+    parser.addHelpOption();
+
+    QCommandLineOption viewsOption("views", "Views to run: " + viewNames.join(",") + ".", "names",
+                                   viewNames.join(","));
+    QCommandLineOption threadsOption("threads", "Comma separated thread counts.", "list",
+                                     "1," + QString::number(QThread::idealThreadCount()));
+    QCommandLineOption repeatsOption("repeats", "Renders per configuration, the fastest is kept.", "n", "3");
+    QCommandLineOption outputOption("output", "JSON output file (default: standard output).", "file");
+    QCommandLineOption noInteriorOption("no-interior-checks", "Disable cardioid/bulb and periodicity checks.");
+    QCommandLineOption marianiSilverOption("mariani-silver", "Use Mariani-Silver subdivision.");
+    QCommandLineOption goldenDirOption("golden-dir", "Directory of the golden iteration buffers.", "dir",
+                                       MANDELBROT_GOLDEN_DIR);
+    QCommandLineOption noGoldenOption("no-golden", "Skip the golden check.");
+    QCommandLineOption updateGoldenOption("update-golden", "Regenerate the golden iteration buffers.");
+
+    parser.addOption(viewsOption);
+    parser.addOption(threadsOption);
+    parser.addOption(repeatsOption);
+    parser.addOption(outputOption);
+    parser.addOption(noInteriorOption);
+    parser.addOption(marianiSilverOption);
+    parser.addOption(goldenDirOption);
+    parser.addOption(noGoldenOption);
+    parser.addOption(updateGoldenOption);
+    parser.process(app);
+
+    bool threadsOk = false;
+    bool repeatsOk = false;
+    QVector<int> threadCounts = parseList(parser.value(threadsOption), &threadsOk);
+    int repeats = parser.value(repeatsOption).toInt(&repeatsOk);
+    if (!threadsOk || !repeatsOk || repeats < 1) {
+        fprintf(stderr, "threads and repeats must be positive\n");
+        return 1;
+    }
+
+    QStringList selectedViews = parser.value(viewsOption).split(',');
+    for (const QString &name : selectedViews) {
+        if (!viewNames.contains(name)) {
+            fprintf(stderr, "unknown view %s\n", qPrintable(name));
+            return 1;
+        }
+    }
+
+    int options = RenderThread::InteriorChecks;
+    if (parser.isSet(noInteriorOption))
+        options &= ~RenderThread::InteriorChecks;
+    if (parser.isSet(marianiSilverOption))
+        options |= RenderThread::MarianiSilver;
+
+    QString goldenDir = parser.value(goldenDirOption);
+    bool checkGolden = !parser.isSet(noGoldenOption);
+    bool updateGolden = parser.isSet(updateGoldenOption);
+    int goldenThreads = threadCounts.last();
+    bool allPassed = true;
+
+    //--float / double 每个指令集各测一次; 更高精度的内核是标量代码, 只用检测到的指令集
+    KernelIsa detectedIsa = detectKernelIsa();
+    QVector<KernelIsa> isas;
+    for (int isa = 0; isa < KernelIsaCount; ++isa) {
+        if (escapeTimeRowFunction(KernelIsa(isa)))
+            isas.append(KernelIsa(isa));
+    }
+
+    QJsonArray results;
+
+    for (const BenchmarkView &view : Views) {
+        if (!selectedViews.contains(view.name))
+            continue;
+
+        QVector<int> golden;
+        bool haveGolden = checkGolden && !updateGolden
+                && loadGolden(goldenFileName(goldenDir, view), view, &golden);
+        if (checkGolden && !updateGolden && !haveGolden)
+            fprintf(stderr, "%s: no golden buffer in %s\n", view.name, qPrintable(goldenDir));
+
+        for (int precision = 0; precision < PrecisionCount; ++precision) {
+            if (!(view.precisions & PRECISION_BIT(precision)))
+                continue;
+
+            for (KernelIsa isa : isas) {
+                if (precision > PrecisionDouble && isa != detectedIsa)
+                    continue;
+
+                //--golden 比较 / 重新生成: 整个视图缩小到 GoldenWidth x GoldenHeight
+                QJsonObject goldenObject;
+                bool goldenRun = haveGolden || (updateGolden && precision == view.goldenPrecision
+                                                && (precision > PrecisionDouble || isa == KernelScalar));
+                if (goldenRun) {
+                    //--Mariani-Silver 填充的矩形不保证与逐像素迭代一致, 比较时不用
+                    RenderResult check = renderView(view, view.scaleFactor * view.width / GoldenWidth,
+                                                    QSize(GoldenWidth, GoldenHeight), isa,
+                                                    KernelPrecision(precision), goldenThreads,
+                                                    options & ~RenderThread::MarianiSilver, true);
+                    if (check.precision != precision || check.isa != isa) {
+                        //--精度不足或编译器不支持, RenderThread 改用了别的内核
+                    } else if (haveGolden) {
+                        bool passed = false;
+                        goldenObject = compareGolden(check.iterationMap, golden,
+                                                     KernelPrecision(precision), &passed);
+                        allPassed = allPassed && passed;
+                    } else if (!saveGolden(goldenFileName(goldenDir, view), view, check.iterationMap)) {
+                        fprintf(stderr, "cannot write %s\n", qPrintable(goldenFileName(goldenDir, view)));
+                        return 1;
+                    }
+                }
+
+                for (int threads : threadCounts) {
+                    RenderResult best;
+                    for (int i = 0; i < repeats; ++i) {
+                        RenderResult result = renderView(view, view.scaleFactor,
+                                                         QSize(view.width, view.height), isa,
+                                                         KernelPrecision(precision), threads, options, false);
+                        if (i == 0 || result.ms < best.ms)
+                            best = result;
+                    }
+
+                    if (best.precision != precision || best.isa != isa) {
+                        fprintf(stderr, "%s: %s/%s not available, skipped\n", view.name,
+                                kernelIsaName(isa), precisionName(KernelPrecision(precision)));
+                        break;
+                    }
+
+                    double seconds = best.ms * 1e-3;
+                    QJsonArray passes;
+                    for (int i = 0; i < best.passMs.size(); ++i) {
+                        QJsonObject pass;
+                        pass["maxIterations"] = best.passMaxIterations[i];
+                        pass["ms"] = best.passMs[i];
+                        passes.append(pass);
+                    }
+
+                    QJsonObject object;
+                    object["view"] = view.name;
+                    object["isa"] = kernelIsaName(best.isa);
+                    object["precision"] = precisionName(best.precision);
+                    object["threads"] = threads;
+                    object["width"] = view.width;
+                    object["height"] = view.height;
+                    object["maxIterations"] = view.maxIterations;
+                    object["ms"] = best.ms;
+                    object["pixels"] = best.stats.pixels;
+                    object["iterations"] = best.stats.iterations;
+                    object["pixelsPerSecond"] = best.stats.pixels / seconds;
+                    object["iterationsPerSecond"] = best.stats.iterations / seconds;
+                    object["references"] = best.stats.references;
+                    object["handoffUs"] = best.stats.handoffNs * 1e-3;
+                    object["colorUs"] = best.stats.colorNs * 1e-3;
+                    object["passes"] = passes;
+                    if (!goldenObject.isEmpty())
+                        object["golden"] = goldenObject;
+                    results.append(object);
+
+                    fprintf(stderr, "%-8s %-6s %-13s %2d threads: %9.1f ms, %8.1f Mpixel/s, %8.1f Miter/s%s\n",
+                            view.name, kernelIsaName(best.isa), precisionName(best.precision), threads,
+                            best.ms, best.stats.pixels / seconds * 1e-6, best.stats.iterations / seconds * 1e-6,
+                            goldenObject.isEmpty() ? ""
+                                                   : goldenObject["passed"].toBool() ? ", golden ok"
+                                                                                     : ", golden FAILED");
+                }
+            }
+        }
+    }
+
+    QJsonObject machine;
+    machine["cpu"] = QSysInfo::currentCpuArchitecture();
+    machine["idealThreadCount"] = QThread::idealThreadCount();
+    machine["detectedIsa"] = kernelIsaName(detectedIsa);
+
+    QJsonObject document;
+    document["machine"] = machine;
+    document["repeats"] = repeats;
+    document["interiorChecks"] = bool(options & RenderThread::InteriorChecks);
+    document["marianiSilver"] = bool(options & RenderThread::MarianiSilver);
+    document["results"] = results;
+    document["goldenPassed"] = allPassed;
+
+    QByteArray json = QJsonDocument(document).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+            fprintf(stderr, "cannot write %s\n", qPrintable(parser.value(outputOption)));
+            return 1;
+        }
+    } else {
+        fwrite(json.constData(), 1, json.size(), stdout);
+    }
+
+    //--golden 不一致时返回非 0, 便于脚本检查
+    return allPassed ? 0 : 2;
+}
@@ -0,0 +1,443 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   上色: 调色板 / 平滑着色 / 直方图均衡
+*
+*           必须以 -ffp-contract=off 编译(见 engine.pri), 平滑着色的多项式不被融合为 FMA,
+*           向量版本与标量版本逐位一致.
+**********************************************************/
+
+#include "colorize.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MANDELBROT_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/// \brief 黑色 qRgb(0, 0, 0)
+static const unsigned int Black = 0xff000000u;
+
+static inline unsigned int rgb(int r, int g, int b)
+{
+    return Black | (unsigned(r) << 16) | (unsigned(g) << 8) | unsigned(b);
+}
+
+//! [10]
+/*!
+ * \brief 一个辅助函数，它将波长转换为与32位QImages兼容的RGB值。
+ *        用于生成光谱调色板。
+ * \param wave
+ * \return
+ */
+static unsigned int rgbFromWaveLength(double wave)
+{
+    double r = 0.0;
+    double g = 0.0;
+    double b = 0.0;
+
+    if (wave >= 380.0 && wave <= 440.0) {
+        r = -1.0 * (wave - 440.0) / (440.0 - 380.0);
+        b = 1.0;
+    } else if (wave >= 440.0 && wave <= 490.0) {
+        g = (wave - 440.0) / (490.0 - 440.0);
+        b = 1.0;
+    } else if (wave >= 490.0 && wave <= 510.0) {
+        g = 1.0;
+        b = -1.0 * (wave - 510.0) / (510.0 - 490.0);
+    } else if (wave >= 510.0 && wave <= 580.0) {
+        r = (wave - 510.0) / (580.0 - 510.0);
+        g = 1.0;
+    } else if (wave >= 580.0 && wave <= 645.0) {
+        r = 1.0;
+        g = -1.0 * (wave - 645.0) / (645.0 - 580.0);
+    } else if (wave >= 645.0 && wave <= 780.0) {
+        r = 1.0;
+    }
+
+    double s = 1.0;
+    if (wave > 700.0)
+        s = 0.3 + 0.7 * (780.0 - wave) / (780.0 - 700.0);
+    else if (wave <  420.0)
+        s = 0.3 + 0.7 * (wave - 380.0) / (420.0 - 380.0);
+
+    r = pow(r * s, 0.8);
+    g = pow(g * s, 0.8);
+    b = pow(b * s, 0.8);
+    return rgb(int(r * 255), int(g * 255), int(b * 255));
+}
+//! [10]
+
+/*!
+ * \brief 按色标线性插值生成调色板, 色标首尾相同, 循环变色时没有接缝
+ * \param stops 等间距的色标 0xrrggbb, count 个
+ */
+static void fillGradient(const unsigned int *stops, int count, unsigned int *colors)
+{
+    for (int i = 0; i < PaletteSize; ++i) {
+        double position = double(i) * (count - 1) / PaletteSize;
+        int stop = int(position);
+        double t = position - stop;
+
+        unsigned int from = stops[stop];
+        unsigned int to = stops[stop + 1];
+        int channels[3];
+        for (int c = 0; c < 3; ++c) {
+            int shift = 16 - 8 * c;
+            int a = (from >> shift) & 0xff;
+            int b = (to >> shift) & 0xff;
+            channels[c] = int(a + (b - a) * t + 0.5);
+        }
+        colors[i] = rgb(channels[0], channels[1], channels[2]);
+    }
+}
+
+void fillPalette(Palette palette, unsigned int *colors)
+{
+    static const unsigned int fire[] = { 0x000000, 0x7f0000, 0xff3f00, 0xffbf00, 0xffffbf, 0xff7f00, 0x3f0000, 0x000000 };
+    static const unsigned int ocean[] = { 0x000a28, 0x003c78, 0x1e8cc8, 0xa0e6ff, 0xffffff, 0x46a0d2, 0x001e50, 0x000a28 };
+    static const unsigned int grayscale[] = { 0x000000, 0xffffff, 0x000000 };
+
+    switch (palette) {
+    case PaletteFire:
+        fillGradient(fire, int(sizeof(fire) / sizeof(fire[0])), colors);
+        break;
+    case PaletteOcean:
+        fillGradient(ocean, int(sizeof(ocean) / sizeof(ocean[0])), colors);
+        break;
+    case PaletteGrayscale:
+        fillGradient(grayscale, int(sizeof(grayscale) / sizeof(grayscale[0])), colors);
+        break;
+    default:
+        //--原来的颜色空间: 380nm - 780nm
+        for (int i = 0; i < PaletteSize; ++i)
+            colors[i] = rgbFromWaveLength(380.0 + (i * 400.0 / PaletteSize));
+        break;
+    }
+}
+
+const char *paletteName(Palette palette)
+{
+    switch (palette) {
+    case PaletteFire:
+        return "fire";
+    case PaletteOcean:
+        return "ocean";
+    case PaletteGrayscale:
+        return "grayscale";
+    default:
+        return "spectrum";
+    }
+}
+
+void equalizeLevels(const int *histogram, int levelCount, int *levels)
+{
+    long long total = 0;
+    for (int n = 0; n < levelCount; ++n)
+        total += histogram[n];
+
+    //--迭代次数 n 的位置 = 不大于 n 的逃逸像素所占比例 x 调色板大小
+    long long below = 0;
+    for (int n = 0; n < levelCount; ++n) {
+        below += histogram[n];
+        levels[n] = total > 0 ? int(below * (PaletteSize - 1) / total) : 0;
+    }
+}
+
+//--------------------------------------------------------------------
+// 标量版本
+
+/*!
+ * \brief log2 近似: x = 2^e * m, m 在 [1, 2), log2(m) 用 4 次多项式(误差约 1e-4)
+ */
+static inline float fastLog2(float x)
+{
+    int bits;
+    memcpy(&bits, &x, sizeof(bits));
+    float exponent = float((bits >> 23) - 127);
+    bits = (bits & 0x7fffff) | 0x3f800000;
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    float p = -0.056570851f;
+    p = p * m + 0.44717955f;
+    p = p * m - 1.4699568f;
+    p = p * m + 2.8212026f;
+    p = p * m - 1.7417939f;
+    return exponent + p;
+}
+
+/*!
+ * \brief 两色按 weight/256 线性插值
+ */
+static inline unsigned int blendColors(unsigned int from, unsigned int to, int weight)
+{
+    unsigned int color = Black;
+    for (int shift = 0; shift < 24; shift += 8) {
+        int a = (from >> shift) & 0xff;
+        int b = (to >> shift) & 0xff;
+        color |= unsigned(a + (((b - a) * weight) >> 8)) << shift;
+    }
+    return color;
+}
+
+static inline unsigned int pixelColor(const ColorMap &map, const ColorRow &row, int x)
+{
+    const int mask = PaletteSize - 1;
+    int n = row.iterations[x];
+
+    if (map.options & ColorEqualize) {
+        int level = map.levels[n < map.levelCount - 1 ? n : map.levelCount - 1];
+        return map.colors[(level + map.offset) & mask];
+    }
+
+    if (map.options & ColorSmooth) {
+        //--mu = n + 2 - log2(log2|z|^2), 逃逸后 |z|^2 在 (4, 约 40) 内, 小数部分在 (-0.6, 1) 内;
+        //--Mariani-Silver 填充的像素 z 记为 2 + 0i, 即 |z|^2 = 4
+        float magnitude = float((row.zr[x] * row.zr[x]) + (row.zi[x] * row.zi[x]));
+        magnitude = magnitude > 4.0f ? magnitude : 4.0f;
+        float fraction = 2.0f - fastLog2(fastLog2(magnitude));
+        float whole = floorf(fraction);
+        int index = n + int(whole);
+        int weight = int((fraction - whole) * 256.0f);
+        if (weight > 255)
+            weight = 255;
+        return blendColors(map.colors[(index + map.offset) & mask],
+                           map.colors[(index + 1 + map.offset) & mask], weight);
+    }
+
+    return map.colors[(n + map.offset) & mask];
+}
+
+static bool colorColumnsScalar(const ColorMap &map, const ColorRow &row, int first, int count)
+{
+    bool escaped = false;
+    for (int x = first; x < count; ++x) {
+        if (row.status[x] == PixelEscaped) {
+            row.pixels[x] = pixelColor(map, row, x);
+            escaped = true;
+        } else {
+            row.pixels[x] = Black;
+        }
+    }
+    return escaped;
+}
+
+static bool colorRowScalar(const ColorMap &map, const ColorRow &row, int count)
+{
+    return colorColumnsScalar(map, row, 0, count);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+
+//--------------------------------------------------------------------
+// AVX2: 8 个像素
+
+__attribute__((target("avx2")))
+static inline __m256 fastLog2Avx2(__m256 x)
+{
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srai_epi32(bits, 23), _mm256_set1_epi32(127)));
+    bits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x7fffff)), _mm256_set1_epi32(0x3f800000));
+    __m256 m = _mm256_castsi256_ps(bits);
+
+    __m256 p = _mm256_set1_ps(-0.056570851f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, m), _mm256_set1_ps(0.44717955f));
+    p = _mm256_sub_ps(_mm256_mul_ps(p, m), _mm256_set1_ps(1.4699568f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, m), _mm256_set1_ps(2.8212026f));
+    p = _mm256_sub_ps(_mm256_mul_ps(p, m), _mm256_set1_ps(1.7417939f));
+    return _mm256_add_ps(exponent, p);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blendColorsAvx2(__m256i from, __m256i to, __m256i weight)
+{
+    const __m256i byte = _mm256_set1_epi32(0xff);
+    __m256i color = _mm256_set1_epi32(int(Black));
+
+    __m256i a = _mm256_and_si256(from, byte);
+    __m256i b = _mm256_and_si256(to, byte);
+    color = _mm256_or_si256(color, _mm256_add_epi32(a, _mm256_srai_epi32(
+                                _mm256_mullo_epi32(_mm256_sub_epi32(b, a), weight), 8)));
+
+    a = _mm256_and_si256(_mm256_srli_epi32(from, 8), byte);
+    b = _mm256_and_si256(_mm256_srli_epi32(to, 8), byte);
+    color = _mm256_or_si256(color, _mm256_slli_epi32(_mm256_add_epi32(a, _mm256_srai_epi32(
+                                _mm256_mullo_epi32(_mm256_sub_epi32(b, a), weight), 8)), 8));
+
+    a = _mm256_and_si256(_mm256_srli_epi32(from, 16), byte);
+    b = _mm256_and_si256(_mm256_srli_epi32(to, 16), byte);
+    color = _mm256_or_si256(color, _mm256_slli_epi32(_mm256_add_epi32(a, _mm256_srai_epi32(
+                                _mm256_mullo_epi32(_mm256_sub_epi32(b, a), weight), 8)), 16));
+    return color;
+}
+
+__attribute__((target("avx2")))
+static bool colorRowAvx2(const ColorMap &map, const ColorRow &row, int count)
+{
+    const int *colors = reinterpret_cast<const int *>(map.colors);
+    const __m256i mask = _mm256_set1_epi32(PaletteSize - 1);
+    const __m256i offset = _mm256_set1_epi32(map.offset);
+    const __m256i escapedStatus = _mm256_set1_epi32(PixelEscaped);
+    const __m256i black = _mm256_set1_epi32(int(Black));
+    __m256i any = _mm256_setzero_si256();
+
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row.iterations + x));
+        __m256i status = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row.status + x)));
+        __m256i escaped = _mm256_cmpeq_epi32(status, escapedStatus);
+        __m256i color;
+
+        if (map.options & ColorEqualize) {
+            __m256i level = _mm256_min_epi32(n, _mm256_set1_epi32(map.levelCount - 1));
+            level = _mm256_i32gather_epi32(map.levels, level, 4);
+            color = _mm256_i32gather_epi32(colors, _mm256_and_si256(_mm256_add_epi32(level, offset), mask), 4);
+        } else if (map.options & ColorSmooth) {
+            //--|z|^2 按 double 计算再转 float, 与标量相同; 未逃逸通道的结果有限, 最后被黑色替换
+            __m256d zr = _mm256_loadu_pd(row.zr + x);
+            __m256d zi = _mm256_loadu_pd(row.zi + x);
+            __m128 low = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi)));
+            zr = _mm256_loadu_pd(row.zr + x + 4);
+            zi = _mm256_loadu_pd(row.zi + x + 4);
+            __m128 high = _mm256_cvtpd_ps(_mm256_add_pd(_mm256_mul_pd(zr, zr), _mm256_mul_pd(zi, zi)));
+            __m256 magnitude = _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+            magnitude = _mm256_max_ps(magnitude, _mm256_set1_ps(4.0f));
+
+            __m256 fraction = _mm256_sub_ps(_mm256_set1_ps(2.0f), fastLog2Avx2(fastLog2Avx2(magnitude)));
+            __m256 whole = _mm256_floor_ps(fraction);
+            __m256i index = _mm256_add_epi32(_mm256_add_epi32(n, _mm256_cvttps_epi32(whole)), offset);
+            __m256i weight = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(fraction, whole), _mm256_set1_ps(256.0f)));
+            weight = _mm256_min_epi32(weight, _mm256_set1_epi32(255));
+
+            __m256i from = _mm256_i32gather_epi32(colors, _mm256_and_si256(index, mask), 4);
+            __m256i to = _mm256_i32gather_epi32(colors, _mm256_and_si256(_mm256_add_epi32(index, _mm256_set1_epi32(1)), mask), 4);
+            color = blendColorsAvx2(from, to, weight);
+        } else {
+            color = _mm256_i32gather_epi32(colors, _mm256_and_si256(_mm256_add_epi32(n, offset), mask), 4);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(row.pixels + x), _mm256_blendv_epi8(black, color, escaped));
+        any = _mm256_or_si256(any, escaped);
+    }
+
+    bool escaped = colorColumnsScalar(map, row, x, count);
+    return escaped || !_mm256_testz_si256(any, any);
+}
+
+//--------------------------------------------------------------------
+// AVX-512: 16 个像素
+//--非掩码的移位 / 转换 / min / gather 以未定义值为源操作数, GCC 12 报 -Wmaybe-uninitialized;
+//--用全 1 掩码(AllLanes)的 maskz_ / mask_ 版本, 源操作数取 0, 生成的指令相同
+
+static const __mmask16 AllLanes = 0xffff;
+
+__attribute__((target("avx512f")))
+static inline __m512 fastLog2Avx512(__m512 x)
+{
+    __m512i bits = _mm512_castps_si512(x);
+    __m512i biased = _mm512_maskz_srai_epi32(AllLanes, bits, 23);
+    __m512 exponent = _mm512_maskz_cvtepi32_ps(AllLanes, _mm512_sub_epi32(biased, _mm512_set1_epi32(127)));
+    bits = _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x7fffff)), _mm512_set1_epi32(0x3f800000));
+    __m512 m = _mm512_castsi512_ps(bits);
+
+    __m512 p = _mm512_set1_ps(-0.056570851f);
+    p = _mm512_add_ps(_mm512_mul_ps(p, m), _mm512_set1_ps(0.44717955f));
+    p = _mm512_sub_ps(_mm512_mul_ps(p, m), _mm512_set1_ps(1.4699568f));
+    p = _mm512_add_ps(_mm512_mul_ps(p, m), _mm512_set1_ps(2.8212026f));
+    p = _mm512_sub_ps(_mm512_mul_ps(p, m), _mm512_set1_ps(1.7417939f));
+    return _mm512_add_ps(exponent, p);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512i blendColorsAvx512(__m512i from, __m512i to, __m512i weight)
+{
+    const __m512i byte = _mm512_set1_epi32(0xff);
+    __m512i color = _mm512_set1_epi32(int(Black));
+
+    for (int shift = 0; shift < 24; shift += 8) {
+        __m512i a = _mm512_and_si512(_mm512_maskz_srli_epi32(AllLanes, from, shift), byte);
+        __m512i b = _mm512_and_si512(_mm512_maskz_srli_epi32(AllLanes, to, shift), byte);
+        __m512i channel = _mm512_add_epi32(a, _mm512_maskz_srai_epi32(AllLanes, _mm512_mullo_epi32(_mm512_sub_epi32(b, a), weight), 8));
+        color = _mm512_or_si512(color, _mm512_maskz_slli_epi32(AllLanes, channel, shift));
+    }
+    return color;
+}
+
+__attribute__((target("avx512f")))
+static bool colorRowAvx512(const ColorMap &map, const ColorRow &row, int count)
+{
+    const __m512i mask = _mm512_set1_epi32(PaletteSize - 1);
+    const __m512i offset = _mm512_set1_epi32(map.offset);
+    const __m512i escapedStatus = _mm512_set1_epi32(PixelEscaped);
+    const __m512i black = _mm512_set1_epi32(int(Black));
+    const __m512i zero = _mm512_setzero_si512();
+    __mmask16 any = 0;
+
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m512i n = _mm512_loadu_si512(row.iterations + x);
+        __m512i status = _mm512_maskz_cvtepu8_epi32(AllLanes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(row.status + x)));
+        __mmask16 escaped = _mm512_cmpeq_epi32_mask(status, escapedStatus);
+        __m512i color;
+
+        if (map.options & ColorEqualize) {
+            __m512i level = _mm512_maskz_min_epi32(AllLanes, n, _mm512_set1_epi32(map.levelCount - 1));
+            level = _mm512_mask_i32gather_epi32(zero, AllLanes, level, map.levels, 4);
+            color = _mm512_mask_i32gather_epi32(zero, AllLanes, _mm512_and_si512(_mm512_add_epi32(level, offset), mask),
+                                                map.colors, 4);
+        } else if (map.options & ColorSmooth) {
+            __m512d zr = _mm512_loadu_pd(row.zr + x);
+            __m512d zi = _mm512_loadu_pd(row.zi + x);
+            __m256 low = _mm512_maskz_cvtpd_ps(0xff, _mm512_add_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi)));
+            zr = _mm512_loadu_pd(row.zr + x + 8);
+            zi = _mm512_loadu_pd(row.zi + x + 8);
+            __m256 high = _mm512_maskz_cvtpd_ps(0xff, _mm512_add_pd(_mm512_mul_pd(zr, zr), _mm512_mul_pd(zi, zi)));
+            __m512d halves = _mm512_maskz_insertf64x4(0xff, _mm512_setzero_pd(), _mm256_castps_pd(low), 0);
+            __m512 magnitude = _mm512_castpd_ps(_mm512_maskz_insertf64x4(0xff, halves, _mm256_castps_pd(high), 1));
+            magnitude = _mm512_maskz_max_ps(AllLanes, magnitude, _mm512_set1_ps(4.0f));
+
+            __m512 fraction = _mm512_sub_ps(_mm512_set1_ps(2.0f), fastLog2Avx512(fastLog2Avx512(magnitude)));
+            __m512 whole = _mm512_maskz_roundscale_ps(AllLanes, fraction, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+            __m512i index = _mm512_add_epi32(_mm512_add_epi32(n, _mm512_maskz_cvttps_epi32(AllLanes, whole)), offset);
+            __m512i weight = _mm512_maskz_cvttps_epi32(AllLanes, _mm512_mul_ps(_mm512_sub_ps(fraction, whole), _mm512_set1_ps(256.0f)));
+            weight = _mm512_maskz_min_epi32(AllLanes, weight, _mm512_set1_epi32(255));
+
+            __m512i from = _mm512_mask_i32gather_epi32(zero, AllLanes, _mm512_and_si512(index, mask), map.colors, 4);
+            __m512i to = _mm512_mask_i32gather_epi32(zero, AllLanes,
+                                                     _mm512_and_si512(_mm512_add_epi32(index, _mm512_set1_epi32(1)), mask),
+                                                     map.colors, 4);
+            color = blendColorsAvx512(from, to, weight);
+        } else {
+            color = _mm512_mask_i32gather_epi32(zero, AllLanes, _mm512_and_si512(_mm512_add_epi32(n, offset), mask),
+                                                map.colors, 4);
+        }
+
+        _mm512_storeu_si512(row.pixels + x, _mm512_mask_blend_epi32(escaped, black, color));
+        any |= escaped;
+    }
+
+    bool escaped = colorColumnsScalar(map, row, x, count);
+    return escaped || any != 0;
+}
+
+#endif // MANDELBROT_X86_SIMD
+
+ColorRowFunction colorRowFunction(KernelIsa isa)
+{
+#ifdef MANDELBROT_X86_SIMD
+    switch (isa) {
+    case KernelAvx512:
+        return colorRowAvx512;
+    case KernelAvx2:
+        return colorRowAvx2;
+    default:
+        break;
+    }
+#else
+    (void)isa;
+#endif
+    return colorRowScalar;
+}
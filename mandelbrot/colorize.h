@@ -0,0 +1,89 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   按迭代状态上色: 调色板 / 平滑着色 / 直方图均衡, 标量 / AVX2 / AVX-512
+*
+*           迭代状态缓冲区保存每个像素的迭代次数、状态和逃逸时的 z,
+*           上色只读这些数据写图像: 换调色板、循环变色、直方图均衡都不必重新迭代.
+*           平滑着色: 逃逸时 |z|^2 > 4, 连续迭代次数 mu = n + 2 - log2(log2|z|^2),
+*               小数部分在调色板相邻两色之间线性插值; log2 用多项式近似.
+*           直方图均衡: 按逃逸像素迭代次数的累积分布分配调色板位置, 颜色在图像中均匀分布.
+*           AVX2 / AVX-512 一次 8 / 16 个像素, 调色板按下标 gather;
+*           SSE2 没有 gather, 用标量版本. 各版本运算顺序相同, 结果逐位一致.
+**********************************************************/
+
+#ifndef COLORIZE_H
+#define COLORIZE_H
+
+#include "mandelbrotkernel.h"
+
+/*!
+ * \brief 调色板
+ */
+enum Palette {
+    PaletteSpectrum,        //--可见光波长 380nm - 780nm
+    PaletteFire,
+    PaletteOcean,
+    PaletteGrayscale,
+    PaletteCount
+};
+
+/*!
+ * \brief 上色方式, 可组合
+ */
+enum ColorOption {
+    ColorSmooth = 0x1,      //--平滑着色, 消除迭代次数的色带
+    ColorEqualize = 0x2     //--直方图均衡, 只按整数迭代次数(优先于平滑)
+};
+
+/// \brief 调色板颜色数, 2 的幂, 下标按位与取模
+enum { PaletteSize = 512 };
+
+/*!
+ * \brief 生成调色板的 PaletteSize 个颜色(Format_RGB32, 0xffrrggbb)
+ */
+void fillPalette(Palette palette, unsigned int *colors);
+
+const char *paletteName(Palette palette);
+
+/*!
+ * \brief 一次上色的参数, 所有行共用
+ */
+struct ColorMap
+{
+    const unsigned int *colors;     //--PaletteSize 个颜色
+    int offset;                     //--循环变色: 调色板下标的偏移
+    int options;                    //--ColorOption
+    const int *levels;              //--直方图均衡: 迭代次数 n 的调色板位置 levels[min(n, levelCount - 1)]
+    int levelCount;
+};
+
+/*!
+ * \brief 一行像素的迭代状态和对应的图像扫描线
+ */
+struct ColorRow
+{
+    const int *iterations;
+    const unsigned char *status;    //--PixelStatus
+    const double *zr;               //--逃逸像素为逃逸时的 z
+    const double *zi;
+    unsigned int *pixels;
+};
+
+/*!
+ * \brief 给一行前 count 个像素上色, 逃逸像素取调色板颜色, 其余黑色
+ * \return 是否有逃逸像素
+ */
+typedef bool (*ColorRowFunction)(const ColorMap &map, const ColorRow &row, int count);
+
+/*!
+ * \brief 指定指令集的上色函数, 不支持 gather 的指令集返回标量版本
+ */
+ColorRowFunction colorRowFunction(KernelIsa isa);
+
+/*!
+ * \brief 直方图均衡: 由逃逸像素迭代次数的直方图(levelCount 项)计算每个迭代次数的调色板位置
+ */
+void equalizeLevels(const int *histogram, int levelCount, int *levels);
+
+#endif // COLORIZE_H
@@ -0,0 +1,30 @@
+# 渲染引擎(RenderThread 与各内核), 只依赖 QtCore / QtGui(QImage);
+# 界面程序 mandelbrot.pro 与命令行批量渲染 batch/batch.pro 共用
+
+INCLUDEPATH  += $$PWD
+
+HEADERS      += $$PWD/colorize.h \
+                $$PWD/fractalkernel.h \
+                $$PWD/framering.h \
+                $$PWD/iterationschedule.h \
+                $$PWD/mandelbrotkernel.h \
+                $$PWD/mpfloat.h \
+                $$PWD/perturbation.h \
+                $$PWD/precisionkernel.h \
+                $$PWD/renderthread.h \
+                $$PWD/tilecache.h
+SOURCES      += $$PWD/colorize.cpp \
+                $$PWD/fractalkernel.cpp \
+                $$PWD/framering.cpp \
+                $$PWD/iterationschedule.cpp \
+                $$PWD/mandelbrotkernel.cpp \
+                $$PWD/mpfloat.cpp \
+                $$PWD/perturbation.cpp \
+                $$PWD/precisionkernel.cpp \
+                $$PWD/renderthread.cpp \
+                $$PWD/tilecache.cpp
+
+# SIMD 内核、上色与标量版本逐位一致, 不允许把乘加融合为 FMA
+gcc|clang: QMAKE_CXXFLAGS += -ffp-contract=off
+
+unix:!mac:!vxworks:!integrity:!haiku:LIBS += -lm
@@ -0,0 +1,403 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   其他分形的逃逸时间内核: 公式模板 x 指令集
+*
+*           Formula<Family, Exponent, EscapeRadius> 给出一次迭代, 标量和向量版本的
+*           像素循环都以它为模板参数, 分形的选择全部在编译期完成;
+*           向量版本用 GCC 向量扩展, 由调用函数的 target 属性决定生成 SSE2 / AVX2 / AVX-512 指令.
+*           必须以 -ffp-contract=off 编译(见 engine.pri), 结果与标量版本逐位一致.
+**********************************************************/
+
+#include "fractalkernel.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FRACTAL_X86_SIMD
+#endif
+
+/// \brief 逃逸半径 2: |K| <= 2 的 Julia 集、各幂次的 Multibrot 和 Burning Ship, |z| > 2 之后都发散
+enum { EscapeRadius = 2 };
+
+//--------------------------------------------------------------------
+// 迭代公式, T 为 double 或 GCC 向量类型
+
+///--x = |x|; 标量和向量写法相同, -0 保持为 -0, 两种版本结果逐位一致;
+///--向量一律按引用/指针传递, 不按值跨越 target 属性不同的函数
+template <typename T>
+static inline __attribute__((always_inline)) void makeAbsolute(T *x)
+{
+    *x = *x < 0 ? -*x : *x;
+}
+
+/*!
+ * \brief Z^Exponent = Z^(Exponent-1) * Z, 编译期展开为 Exponent - 1 次复数乘法
+ *        虚部取反时实部不变、虚部逐位取反, 保持共轭对称
+ */
+template <int Exponent>
+struct ComplexPower
+{
+    template <typename T>
+    static inline __attribute__((always_inline)) void apply(const T &a, const T &b, T *ra, T *rb)
+    {
+        T pa;
+        T pb;
+        ComplexPower<Exponent - 1>::apply(a, b, &pa, &pb);
+        *ra = (pa * a) - (pb * b);
+        *rb = (pa * b) + (pb * a);
+    }
+};
+
+template <>
+struct ComplexPower<1>
+{
+    template <typename T>
+    static inline __attribute__((always_inline)) void apply(const T &a, const T &b, T *ra, T *rb)
+    {
+        *ra = a;
+        *rb = b;
+    }
+};
+
+/*!
+ * \brief 一次迭代 Z = f(Z) + C; Julia 的 C 为常数 K, z 从像素开始; 其他分形 C 为像素, z 从 C 开始
+ */
+template <int Family, int Exponent, int Radius>
+struct Formula
+{
+    enum { Julia = Family == FractalJulia };
+
+    static double limit() { return double(Radius) * Radius; }
+
+    template <typename T>
+    static inline __attribute__((always_inline)) void step(T *a, T *b, const T &cx, const T &cy)
+    {
+        T x = *a;
+        T y = *b;
+        if (Family == FractalBurningShip) {
+            makeAbsolute(&x);
+            makeAbsolute(&y);
+        }
+
+        T pa;
+        T pb;
+        ComplexPower<Exponent>::apply(x, y, &pa, &pb);
+        *a = pa + cx;
+        *b = pb + cy;
+    }
+};
+
+//--------------------------------------------------------------------
+// 标量版本
+
+template <typename F>
+static inline void fractalPixel(const EscapeTimeRow &row, int column,
+                                int startIteration, int maxIterations)
+{
+    double px = row.centerX + ((row.x0 + column) * row.scaleFactor);
+    double py = row.ay;
+    double cx = F::Julia ? row.juliaX : px;
+    double cy = F::Julia ? row.juliaY : py;
+
+    double a = px;
+    double b = py;
+    if (startIteration > 0) {
+        a = row.zr[column];
+        b = row.zi[column];
+    }
+
+    int numIterations = startIteration;
+
+    //--Brent 周期检测, 同 mandelbrotkernel.cpp: 轨道回到记录值后按相同运算永远重复
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+    double savedA = a;
+    double savedB = b;
+    int checkpoint = numIterations + 1;
+    int window = 1;
+
+    while (numIterations < maxIterations) {
+        ++numIterations;
+        F::step(&a, &b, cx, cy);
+
+        if ((a * a) + (b * b) > F::limit()) {
+            row.status[column] = PixelEscaped;
+            break;
+        }
+
+        if (periodicity) {
+            if (a == savedA && b == savedB) {
+                row.status[column] = PixelPeriodic;
+                break;
+            }
+            if (numIterations == checkpoint) {
+                savedA = a;
+                savedB = b;
+                window <<= 1;
+                checkpoint += window;
+            }
+        }
+    }
+
+    row.zr[column] = a;
+    row.zi[column] = b;
+    row.iterations[column] = numIterations;
+}
+
+template <typename F>
+static void fractalRowScalar(const EscapeTimeRow &row, int *columns, int count,
+                             int startIteration, int maxIterations)
+{
+    for (int i = 0; i < count; ++i)
+        fractalPixel<F>(row, columns[i], startIteration, maxIterations);
+}
+
+#ifdef FRACTAL_X86_SIMD
+
+//--------------------------------------------------------------------
+// 向量版本: 同 precisionkernel.cpp 的 float 向量内核, 通道为 double
+
+typedef double Double2 __attribute__((vector_size(16)));
+typedef long long Long2 __attribute__((vector_size(16)));
+typedef double Double4 __attribute__((vector_size(32)));
+typedef long long Long4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+typedef long long Long8 __attribute__((vector_size(64)));
+
+/*!
+ * \brief Lanes 个像素同时迭代, 已逃逸/已检测到周期的通道用掩码冻结, 每 8 次迭代检查一次是否全部结束
+ */
+template <typename F, typename Vector, typename Mask, int Lanes>
+static inline __attribute__((always_inline))
+void fractalLanes(const EscapeTimeRow &row, const int *columns, int startIteration, int maxIterations)
+{
+    Vector cx;
+    Vector a;
+    Vector b;
+    for (int lane = 0; lane < Lanes; ++lane) {
+        double px = row.centerX + ((row.x0 + columns[lane]) * row.scaleFactor);
+        cx[lane] = F::Julia ? row.juliaX : px;
+        a[lane] = startIteration > 0 ? row.zr[columns[lane]] : px;
+        b[lane] = startIteration > 0 ? row.zi[columns[lane]] : row.ay;
+    }
+
+    const Vector cy = (F::Julia ? row.juliaY : row.ay) - Vector();
+    const Vector vLimit = F::limit() - Vector();
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+
+    Mask active = Mask() == Mask();
+    Mask periodic = Mask();
+    Mask counts = maxIterations - Mask();
+
+    Vector savedA = a;
+    Vector savedB = b;
+    int checkpoint = startIteration + 1;
+    int window = 1;
+
+    for (int n = startIteration + 1; n <= maxIterations; ++n) {
+        Vector a2 = a;
+        Vector b2 = b;
+        F::step(&a2, &b2, cx, cy);
+        Vector mag = (a2 * a2) + (b2 * b2);
+
+        Mask escaped = (mag > vLimit) & active;
+        counts = escaped ? n - Mask() : counts;
+
+        a = active ? a2 : a;
+        b = active ? b2 : b;
+        active &= ~escaped;
+
+        if (periodicity) {
+            Mask cycle = (a == savedA) & (b == savedB) & active;
+            counts = cycle ? n - Mask() : counts;
+            periodic |= cycle;
+            active &= ~cycle;
+
+            if (n == checkpoint) {
+                savedA = a;
+                savedB = b;
+                window <<= 1;
+                checkpoint += window;
+            }
+        }
+
+        if ((n & 7) == 0) {
+            long long any = 0;
+            for (int lane = 0; lane < Lanes; ++lane)
+                any |= active[lane];
+            if (!any)
+                break;
+        }
+    }
+
+    for (int lane = 0; lane < Lanes; ++lane) {
+        int column = columns[lane];
+        row.zr[column] = a[lane];
+        row.zi[column] = b[lane];
+        row.iterations[column] = int(counts[lane]);
+        if (periodic[lane])
+            row.status[column] = PixelPeriodic;
+        else if (!active[lane])
+            row.status[column] = PixelEscaped;
+    }
+}
+
+template <typename F, typename Vector, typename Mask, int Lanes>
+static inline __attribute__((always_inline))
+void fractalRowVector(const EscapeTimeRow &row, int *columns, int count,
+                      int startIteration, int maxIterations)
+{
+    int i = 0;
+    for (; i + Lanes <= count; i += Lanes)
+        fractalLanes<F, Vector, Mask, Lanes>(row, columns + i, startIteration, maxIterations);
+
+    //--不足一个向量的剩余像素用最后一列补满通道, 重复的通道结果相同, 重复写回无妨
+    if (i < count) {
+        int padded[Lanes];
+        for (int lane = 0; lane < Lanes; ++lane)
+            padded[lane] = columns[lane < count - i ? i + lane : count - 1];
+        fractalLanes<F, Vector, Mask, Lanes>(row, padded, startIteration, maxIterations);
+    }
+}
+
+template <typename F>
+__attribute__((target("sse2")))
+static void fractalRowSse2(const EscapeTimeRow &row, int *columns, int count,
+                           int startIteration, int maxIterations)
+{
+    fractalRowVector<F, Double2, Long2, 2>(row, columns, count, startIteration, maxIterations);
+}
+
+template <typename F>
+__attribute__((target("avx2")))
+static void fractalRowAvx2(const EscapeTimeRow &row, int *columns, int count,
+                           int startIteration, int maxIterations)
+{
+    fractalRowVector<F, Double4, Long4, 4>(row, columns, count, startIteration, maxIterations);
+}
+
+template <typename F>
+__attribute__((target("avx512f")))
+static void fractalRowAvx512(const EscapeTimeRow &row, int *columns, int count,
+                             int startIteration, int maxIterations)
+{
+    fractalRowVector<F, Double8, Long8, 8>(row, columns, count, startIteration, maxIterations);
+}
+
+#endif // FRACTAL_X86_SIMD
+
+/*!
+ * \brief 一个公式按指令集选择内核, 约定同 escapeTimeRowFunction()
+ */
+template <typename F>
+static EscapeTimeRowFunction formulaRowFunction(KernelIsa isa)
+{
+    switch (isa) {
+    case KernelScalar:
+        return fractalRowScalar<F>;
+#ifdef FRACTAL_X86_SIMD
+    case KernelSse2:
+        return __builtin_cpu_supports("sse2") ? fractalRowSse2<F> : nullptr;
+    case KernelAvx2:
+        return __builtin_cpu_supports("avx2") ? fractalRowAvx2<F> : nullptr;
+    case KernelAvx512:
+        return __builtin_cpu_supports("avx512f") ? fractalRowAvx512<F> : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+EscapeTimeRowFunction fractalRowFunction(const Fractal &fractal, KernelIsa isa)
+{
+    switch (fractal.family) {
+    case FractalMandelbrot:
+        return escapeTimeRowFunction(isa);
+    case FractalJulia:
+        return formulaRowFunction<Formula<FractalJulia, 2, EscapeRadius> >(isa);
+    case FractalBurningShip:
+        return formulaRowFunction<Formula<FractalBurningShip, 2, EscapeRadius> >(isa);
+    case FractalMultibrot:
+        switch (fractal.exponent) {
+        case 3:
+            return formulaRowFunction<Formula<FractalMultibrot, 3, EscapeRadius> >(isa);
+        case 4:
+            return formulaRowFunction<Formula<FractalMultibrot, 4, EscapeRadius> >(isa);
+        case 5:
+            return formulaRowFunction<Formula<FractalMultibrot, 5, EscapeRadius> >(isa);
+        case 6:
+            return formulaRowFunction<Formula<FractalMultibrot, 6, EscapeRadius> >(isa);
+        case 7:
+            return formulaRowFunction<Formula<FractalMultibrot, 7, EscapeRadius> >(isa);
+        case 8:
+            return formulaRowFunction<Formula<FractalMultibrot, 8, EscapeRadius> >(isa);
+        default:
+            return nullptr;
+        }
+    default:
+        return nullptr;
+    }
+}
+
+bool fractalConjugateSymmetric(const Fractal &fractal)
+{
+    switch (fractal.family) {
+    case FractalMandelbrot:
+    case FractalMultibrot:
+        return true;
+    case FractalJulia:
+        return fractal.juliaY == 0;
+    default:
+        return false;
+    }
+}
+
+bool fractalConnected(const Fractal &fractal)
+{
+    switch (fractal.family) {
+    case FractalMandelbrot:
+    case FractalMultibrot:
+        return true;
+    case FractalJulia: {
+        //--K 的临界轨道(从 0 开始)不逃逸则 K 在 Mandelbrot 集内, Julia 集连通;
+        //--1024 次内没逃逸的按连通处理, 离边界很近时填充可能有少量误差
+        double a = 0;
+        double b = 0;
+        for (int n = 0; n < 1024; ++n) {
+            double a2 = (a * a) - (b * b) + fractal.juliaX;
+            b = (2 * a * b) + fractal.juliaY;
+            a = a2;
+            if ((a * a) + (b * b) > double(EscapeRadius) * EscapeRadius)
+                return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+const char *fractalFamilyName(FractalFamily family)
+{
+    switch (family) {
+    case FractalMandelbrot:
+        return "mandelbrot";
+    case FractalJulia:
+        return "julia";
+    case FractalMultibrot:
+        return "multibrot";
+    case FractalBurningShip:
+        return "burning-ship";
+    default:
+        return "unknown";
+    }
+}
+
+int fractalFamilyFromName(const char *name)
+{
+    for (int family = 0; family < FractalFamilyCount; ++family) {
+        if (strcmp(name, fractalFamilyName(FractalFamily(family))) == 0)
+            return family;
+    }
+    return -1;
+}
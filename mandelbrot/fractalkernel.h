@@ -0,0 +1,82 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   其他分形的逃逸时间内核: Julia / Multibrot / Burning Ship
+*
+*           迭代公式(分形族, 幂次)和逃逸半径都是模板参数, 每种组合各生成一份
+*           完全特化的内层循环, 循环中没有按分形选择的分支:
+*               Mandelbrot      Z(n+1) = Zn^2 + C
+*               Julia           Z(n+1) = Zn^2 + K, Z0 为像素, K 为参数
+*               Multibrot       Z(n+1) = Zn^d + C, d = 3..8, 幂按乘法在编译期展开
+*               Burning Ship    Z(n+1) = (|Re Zn| + i|Im Zn|)^2 + C
+*           约定与 mandelbrotkernel.h 相同(同一个 EscapeTimeRow / EscapeTimeRowFunction),
+*           分块、取消、逐轮继续都与 Mandelbrot 共用; 只有 double 精度, 有 Brent 周期检测,
+*           没有主心形判定. 标量版本与 SSE2 / AVX2 / AVX-512 向量版本(GCC 向量扩展)
+*           运算顺序相同, 迭代次数逐位一致.
+*           Mandelbrot 仍用 mandelbrotkernel.cpp 手写的内核(含内部点捷径, 可换其他精度和微扰).
+**********************************************************/
+
+#ifndef FRACTALKERNEL_H
+#define FRACTALKERNEL_H
+
+#include "mandelbrotkernel.h"
+
+/*!
+ * \brief 分形族
+ */
+enum FractalFamily {
+    FractalMandelbrot,
+    FractalJulia,
+    FractalMultibrot,
+    FractalBurningShip,
+    FractalFamilyCount
+};
+
+/// \brief Multibrot 的幂次范围
+enum { MinMultibrotExponent = 3, MaxMultibrotExponent = 8 };
+
+/*!
+ * \brief 要渲染的分形: 分形族, Multibrot 的幂次, Julia 的常数 K = juliaX + i * juliaY
+ */
+struct Fractal
+{
+    FractalFamily family = FractalMandelbrot;
+    int exponent = MinMultibrotExponent;
+    double juliaX = -0.8;
+    double juliaY = 0.156;
+
+    ///--只比较影响迭代结果的参数
+    bool operator==(const Fractal &other) const
+    {
+        return family == other.family
+                && (family != FractalMultibrot || exponent == other.exponent)
+                && (family != FractalJulia || (juliaX == other.juliaX && juliaY == other.juliaY));
+    }
+    bool operator!=(const Fractal &other) const { return !(*this == other); }
+};
+
+/*!
+ * \brief 指定分形和指令集的 double 内核; Mandelbrot 返回 escapeTimeRowFunction(isa),
+ *        幂次超出范围或 CPU / 编译器不支持该指令集时返回 nullptr
+ *        Julia 的常数取自 EscapeTimeRow::juliaX / juliaY
+ */
+EscapeTimeRowFunction fractalRowFunction(const Fractal &fractal, KernelIsa isa);
+
+/*!
+ * \brief 分形的实轴镜像对称: C 与其共轭的迭代逐位互为共轭(Mandelbrot / Multibrot, 实常数的 Julia)
+ */
+bool fractalConjugateSymmetric(const Fractal &fractal);
+
+/*!
+ * \brief 集合是否连通: Mariani-Silver 的边界填充依赖连通性, 不连通时不能用;
+ *        Julia 集在 K 属于 Mandelbrot 集时连通(迭代 K 的临界轨道判断), Burning Ship 按不连通处理
+ */
+bool fractalConnected(const Fractal &fractal);
+
+/*!
+ * \brief 分形族的名称 mandelbrot|julia|multibrot|burning-ship; 按名称反查, 找不到返回 -1
+ */
+const char *fractalFamilyName(FractalFamily family);
+int fractalFamilyFromName(const char *name);
+
+#endif // FRACTALKERNEL_H
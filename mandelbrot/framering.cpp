@@ -0,0 +1,56 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   三缓冲帧环
+**********************************************************/
+
+#include "framering.h"
+
+FrameRing::FrameRing()
+    : ready(1), back(0), serial(0), front(2)
+{
+}
+
+FrameRing::Frame *FrameRing::beginWrite(const QSize &size)
+{
+    Frame *frame = &frames[back];
+    if (frame->image.size() != size) {
+        frame->image = QImage(size, QImage::Format_RGB32);
+        allocations.fetchAndAddRelaxed(1);
+    }
+    return frame;
+}
+
+void FrameRing::publish()
+{
+    frames[back].serial = ++serial;
+
+    //--release: 图像内容先于交换对读端可见
+    int previous = ready.fetchAndStoreOrdered(back | FreshBit);
+    back = previous & IndexMask;
+
+    published.fetchAndAddRelaxed(1);
+    if (previous & FreshBit)
+        dropped.fetchAndAddRelaxed(1);
+}
+
+const FrameRing::Frame *FrameRing::acquire()
+{
+    if (ready.loadAcquire() & FreshBit) {
+        //--acquire: 看到写端发布前写入的图像
+        int previous = ready.fetchAndStoreOrdered(front);
+        front = previous & IndexMask;
+        acquired.fetchAndAddRelaxed(1);
+    }
+    return &frames[front];
+}
+
+FrameRing::Counters FrameRing::counters() const
+{
+    Counters counters;
+    counters.published = published.loadAcquire();
+    counters.acquired = acquired.loadAcquire();
+    counters.dropped = dropped.loadAcquire();
+    counters.allocations = allocations.loadAcquire();
+    return counters;
+}
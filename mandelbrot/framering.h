@@ -0,0 +1,88 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   渲染线程 -> 界面线程的三缓冲帧环, 不复制、不转换
+*
+*           三个 Format_RGB32 图像(raster 绘制引擎可直接绘制, 不必转换为 QPixmap):
+*               写端(渲染线程)独占 back, 读端(界面线程)独占 front, 第三个为 ready.
+*           写完一帧 publish(): back 与 ready 交换并标记为新帧;
+*           读端 acquire(): 有新帧时 front 与 ready 交换.
+*           交换只是一个原子操作, 两端都不会等待对方; 读端来不及取的帧被下一帧覆盖(丢帧).
+*           QImage 不能再被复制出去: 共享后写端 bits() 会分离出副本.
+**********************************************************/
+
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <QAtomicInt>
+#include <QImage>
+
+class FrameRing
+{
+public:
+    /*!
+     * \brief 一帧: 图像及其渲染参数, 由当前持有者独占
+     */
+    struct Frame
+    {
+        QImage image;
+        double scaleFactor = 0;
+        int pass = 0;               //--第几轮的结果
+        qint64 serial = 0;          //--发布序号, 从 1 开始
+        qint64 request = 0;         //--写端的渲染请求序号(RenderThread::render() 的返回值)
+    };
+
+    /*!
+     * \brief 统计
+     */
+    struct Counters
+    {
+        qint64 published;           //--写端发布的帧
+        qint64 acquired;            //--读端取走的帧
+        qint64 dropped;             //--未被取走就被覆盖的帧
+        qint64 allocations;         //--大小改变时重新分配图像的次数
+    };
+
+    FrameRing();
+
+    /*!
+     * \brief 写端: 取得 back 帧, 大小不同时重新分配(内容未定义, 由写端整幅写满)
+     */
+    Frame *beginWrite(const QSize &size);
+
+    /*!
+     * \brief 写端: 发布 back 帧, 之后不能再访问它
+     */
+    void publish();
+
+    /*!
+     * \brief 读端: 有新帧时换入, 返回 front 帧; 直到下一次 acquire() 一直有效, 写端不会访问它
+     *        从未发布过时图像为空(isNull)
+     */
+    const Frame *acquire();
+
+    Counters counters() const;
+
+private:
+    /// \brief ready 下标之外的标志位: ready 是尚未被取走的新帧
+    enum { FreshBit = 4, IndexMask = 3 };
+
+    Frame frames[3];
+
+    ///--ready 下标 | FreshBit, 两端交换的唯一共享状态
+    QAtomicInt ready;
+
+    ///--写端独占
+    int back;
+    qint64 serial;
+
+    ///--读端独占
+    int front;
+
+    QAtomicInteger<qint64> published;
+    QAtomicInteger<qint64> acquired;
+    QAtomicInteger<qint64> dropped;
+    QAtomicInteger<qint64> allocations;
+};
+
+#endif // FRAMERING_H
@@ -0,0 +1,104 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   每轮最大迭代次数的安排
+**********************************************************/
+
+#include "iterationschedule.h"
+
+#include <math.h>
+
+/// \brief 固定安排第一轮 2^6 + 32
+static const int FirstExponent = 6;
+
+/// \brief 自适应: 图像宽度对应复平面上这么长时为缩放深度 0(整个集合)
+static const double FullSpan = 4.0;
+
+IterationSchedule::IterationSchedule()
+    : adaptive(false), maxIterations(0), exponent(FirstExponent), previousLimit(0),
+      currentLimit(0), passIndex(0), finished(false), saved(0)
+{
+}
+
+void IterationSchedule::start(double scaleFactor, int width, int maxIterations, bool adaptive)
+{
+    this->adaptive = adaptive;
+    this->maxIterations = maxIterations;
+    previousLimit = 0;
+    passIndex = 0;
+    finished = false;
+    saved = 0;
+
+    //--缩放深度 = 放大倍数的 log2, 每深一级起点多 32 次迭代(64 + 32 * depth, 向上取到 2^k + 32);
+    //--浅缩放从 2^6 + 32 开始, 与固定安排相同
+    int first = FirstExponent;
+    if (adaptive && scaleFactor > 0 && width > 0) {
+        double depth = log2(FullSpan / (scaleFactor * width));
+        double estimate = 64.0 + 32.0 * (depth > 0 ? depth : 0);
+        while (first < 30 && double((qint64(1) << first) + 32) < estimate)
+            ++first;
+    }
+    setExponent(first);
+}
+
+void IterationSchedule::setExponent(int exponent)
+{
+    this->exponent = exponent;
+    qint64 limit = (qint64(1) << qMin(exponent, 40)) + 32;
+    currentLimit = int(qMin(limit, qint64(maxIterations)));
+}
+
+int IterationSchedule::bin(int iterations) const
+{
+    if (iterations <= previousLimit || iterations > currentLimit)
+        return -1;
+    qint64 offset = iterations - previousLimit - 1;
+    return int(offset * HistogramBins / (currentLimit - previousLimit));
+}
+
+void IterationSchedule::finishPass(const PassSummary &summary)
+{
+    ++passIndex;
+    if (currentLimit >= maxIterations) {
+        finished = true;
+        return;
+    }
+
+    if (!adaptive) {
+        previousLimit = currentLimit;
+        setExponent(2 * passIndex + FirstExponent);
+        return;
+    }
+
+    qint64 changed = 0;
+    qint64 lower = 0;
+    for (int i = 0; i < HistogramBins; ++i) {
+        changed += summary.histogram[i];
+        if (i < HistogramBins / 2)
+            lower += summary.histogram[i];
+    }
+    qint64 upper = changed - lower;
+
+    //--没有要继续算的像素; 或第一轮之后新逃逸的像素已经很少(全黑时还没看到轮廓, 继续)
+    bool converged = passIndex > 1 && summary.escapedPixels > 0
+            && changed * 1000000 < summary.pixels * MinChangedPpm;
+    if (summary.unresolvedPixels == 0 || converged) {
+        finished = true;
+        saved = summary.unresolvedPixels * (maxIterations - currentLimit);
+        return;
+    }
+
+    //--后半段的逃逸数不到前半段的一半, 分布衰减得快, 上限只翻倍
+    previousLimit = currentLimit;
+    setExponent(exponent + (summary.escapedPixels == 0 || 2 * upper > lower ? 2 : 1));
+}
+
+void IterationSchedule::skipBlack()
+{
+    if (finished)
+        return;
+    if (adaptive)
+        setExponent(exponent + 2);
+    else
+        setExponent(2 * (passIndex = 4) + FirstExponent);
+}
@@ -0,0 +1,92 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   每轮最大迭代次数的安排: 固定翻 4 倍, 或按缩放深度和逃逸统计自适应
+*
+*           各轮上限都是 2^k + 32 的形式(固定安排 k = 2 * pass + 6), 不超过用户设置的上限;
+*           自适应时 k 的起点随缩放深度增加, 每轮结束后看本轮逃逸像素的迭代次数分布:
+*               分布的后半段仍多(尾部衰减慢)则 k + 2, 否则 k + 1;
+*               本轮新逃逸的像素少于图像的 MinChangedPpm / 10^6 时提前结束(第一轮之后),
+*               没有未确定的像素时也结束.
+*           提前结束时, 固定安排还要把剩下未确定的像素算到上限, 省下的迭代次数按此估算.
+**********************************************************/
+
+#ifndef ITERATIONSCHEDULE_H
+#define ITERATIONSCHEDULE_H
+
+#include <QtGlobal>
+
+class IterationSchedule
+{
+public:
+    /// \brief 本轮逃逸像素的直方图: (上一轮上限, 本轮上限] 等分的区间数
+    enum { HistogramBins = 8 };
+
+    /// \brief 自适应: 新逃逸像素少于百万分之此数时不再加轮
+    enum { MinChangedPpm = 100 };
+
+    /*!
+     * \brief 一轮结束后迭代状态缓冲区的统计
+     */
+    struct PassSummary
+    {
+        qint64 pixels;              //--图像像素数
+        qint64 escapedPixels;       //--已逃逸的像素(含之前各轮)
+        qint64 unresolvedPixels;    //--算到本轮上限仍未确定的像素
+        qint64 histogram[HistogramBins];    //--本轮新逃逸像素的迭代次数分布, 下标为 bin()
+    };
+
+    IterationSchedule();
+
+    /*!
+     * \brief 新的渲染请求: 第一轮的上限
+     * \param scaleFactor 像素间距
+     * \param width 图像宽度(像素)
+     * \param maxIterations 用户设置的上限, 最后一轮不超过此值
+     * \param adaptive 是否自适应, 否则固定翻 4 倍直到 maxIterations
+     */
+    void start(double scaleFactor, int width, int maxIterations, bool adaptive);
+
+    bool isAdaptive() const { return adaptive; }
+
+    /// \brief 下一轮(或刚结束且 isFinished() 的最后一轮)的最大迭代次数
+    int limit() const { return currentLimit; }
+
+    /// \brief 下一轮的序号, 从 0 开始; 第一轮全黑时固定安排跳到第 5 轮
+    int pass() const { return passIndex; }
+
+    /*!
+     * \brief 本轮新逃逸的迭代次数 n 在直方图中的区间, 不在 (上一轮上限, 本轮上限] 内返回 -1
+     */
+    int bin(int iterations) const;
+
+    /*!
+     * \brief 一轮算完: 决定是否结束, 否则给出下一轮的上限; 固定安排不看 summary
+     */
+    void finishPass(const PassSummary &summary);
+
+    /*!
+     * \brief 第一轮全黑(都在轮廓内部)时, 下一轮的上限再加大: 固定安排跳到第 5 轮, 自适应再翻 4 倍
+     */
+    void skipBlack();
+
+    /// \brief 最后一轮已算完
+    bool isFinished() const { return finished; }
+
+    /// \brief 提前结束时, 相对算到 maxIterations 估算省下的迭代次数; 未提前结束为 0
+    qint64 savedIterations() const { return saved; }
+
+private:
+    void setExponent(int exponent);
+
+    bool adaptive;
+    int maxIterations;
+    int exponent;           //--本轮上限 2^exponent + 32
+    int previousLimit;      //--上一轮的上限, 第一轮为 0
+    int currentLimit;
+    int passIndex;
+    bool finished;
+    qint64 saved;
+};
+
+#endif // ITERATIONSCHEDULE_H
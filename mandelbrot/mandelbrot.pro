@@ -1,12 +1,10 @@
 QT += widgets
 
-HEADERS       = mandelbrotwidget.h \
-                renderthread.h
-SOURCES       = main.cpp \
-                mandelbrotwidget.cpp \
-                renderthread.cpp
+include(engine.pri)
 
-unix:!mac:!vxworks:!integrity:!haiku:LIBS += -lm
+HEADERS      += mandelbrotwidget.h
+SOURCES      += main.cpp \
+                mandelbrotwidget.cpp
 
 # install
 target.path = $$[QT_INSTALL_EXAMPLES]/corelib/threads/mandelbrot
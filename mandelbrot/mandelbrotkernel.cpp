@@ -0,0 +1,463 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   Mandelbrot 逃逸时间内核: 标量 / SSE2 / AVX2 / AVX-512
+*
+*           向量版本每条指令同时迭代 2/4/8 个像素, 每个通道独立判断逃逸,
+*           已逃逸的通道用掩码冻结, 全部通道逃逸或达到最大迭代次数时结束.
+*           后续轮次只剩少量未逃逸像素, 按列号把它们紧凑地装入向量通道.
+*           必须以 -ffp-contract=off 编译(见 mandelbrot.pro), 保证乘加不被融合,
+*           结果与标量版本逐位一致.
+**********************************************************/
+
+#include "mandelbrotkernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MANDELBROT_X86_SIMD
+#include <immintrin.h>
+#endif
+
+/// \brief 幅值 Limit = 2^2 = 4
+static const double Limit = 4;
+
+/*!
+ * \brief 标量版本, 继续迭代一个像素
+ */
+static inline void escapeTimePixel(const EscapeTimeRow &row, int column,
+                                   int startIteration, int maxIterations)
+{
+    ///--实部
+    double ax = row.centerX + ((row.x0 + column) * row.scaleFactor);
+    double ay = row.ay;
+
+    double a1 = ax;
+    double b1 = ay;
+    if (startIteration > 0) {
+        a1 = row.zr[column];
+        b1 = row.zi[column];
+    }
+
+    /// \brief 当前迭代次数
+    int numIterations = startIteration;
+
+    //--Brent 周期检测: 在第 1, 3, 7, 15 ... 次迭代记录 z, 之后 z 与记录值完全相等,
+    //--说明轨道已进入周期, 按相同运算永远重复, 不会逃逸
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+    double savedA = a1;
+    double savedB = b1;
+    int checkpoint = numIterations + 1;
+    int window = 1;
+
+    while (numIterations < maxIterations) {
+        ++numIterations;
+
+        //-- Z(n+1)=(Zn)^2+C
+        double a2 = (a1 * a1) - (b1 * b1) + ax;
+        double b2 = (2 * a1 * b1) + ay;
+        a1 = a2;
+        b1 = b2;
+
+        //--直到z的幅值大于2, Limit = 2^2,退出
+        if ((a1 * a1) + (b1 * b1) > Limit) {
+            row.status[column] = PixelEscaped;
+            break;
+        }
+
+        if (periodicity) {
+            if (a1 == savedA && b1 == savedB) {
+                row.status[column] = PixelPeriodic;
+                break;
+            }
+            if (numIterations == checkpoint) {
+                savedA = a1;
+                savedB = b1;
+                window <<= 1;
+                checkpoint += window;
+            }
+        }
+    }
+
+    row.zr[column] = a1;
+    row.zi[column] = b1;
+    row.iterations[column] = numIterations;
+}
+
+static void escapeTimeColumnsScalar(const EscapeTimeRow &row, const int *columns, int count,
+                                    int startIteration, int maxIterations)
+{
+    for (int i = 0; i < count; ++i)
+        escapeTimePixel(row, columns[i], startIteration, maxIterations);
+}
+
+/*!
+ * \brief 首轮把主心形 / 周期 2 圆盘内的像素直接标记为内部, 并换到待迭代列的末尾
+ * \return 剩余待迭代的列数(排在前面)
+ */
+static int filterInterior(const EscapeTimeRow &row, int *columns, int count,
+                          int startIteration)
+{
+    if (startIteration > 0 || !(row.options & EscapeTimeCardioid))
+        return count;
+
+    int remaining = 0;
+    for (int i = 0; i < count; ++i) {
+        int column = columns[i];
+        double ax = row.centerX + ((row.x0 + column) * row.scaleFactor);
+
+        if (insideCardioidOrBulb(ax, row.ay)) {
+            row.zr[column] = ax;
+            row.zi[column] = row.ay;
+            row.iterations[column] = 0;
+            row.status[column] = PixelInsideBulb;
+        } else {
+            columns[i] = columns[remaining];
+            columns[remaining++] = column;
+        }
+    }
+    return remaining;
+}
+
+static void escapeTimeRowScalar(const EscapeTimeRow &row, int *columns, int count,
+                                int startIteration, int maxIterations)
+{
+    count = filterInterior(row, columns, count, startIteration);
+    escapeTimeColumnsScalar(row, columns, count, startIteration, maxIterations);
+}
+
+#ifdef MANDELBROT_X86_SIMD
+
+/*!
+ * \brief 把一个向量的结果写回各通道对应的列
+ * \param activeBits 仍未逃逸通道的位掩码
+ * \param periodicBits 检测到周期的通道的位掩码
+ */
+static inline void storeLanes(const EscapeTimeRow &row, const int *columns, int lanes,
+                              const double *a, const double *b, const double *counts,
+                              unsigned activeBits, unsigned periodicBits)
+{
+    for (int lane = 0; lane < lanes; ++lane) {
+        int column = columns[lane];
+        row.zr[column] = a[lane];
+        row.zi[column] = b[lane];
+        row.iterations[column] = int(counts[lane]);
+        if (periodicBits & (1u << lane))
+            row.status[column] = PixelPeriodic;
+        else if (!(activeBits & (1u << lane)))
+            row.status[column] = PixelEscaped;
+    }
+}
+
+/*!
+ * \brief SSE2 版本, 2 路; x86-64 基础指令集, 无需运行时检测
+ *        待迭代的列不一定连续, 逐通道装入/写回, 迭代本身全部在寄存器中
+ */
+__attribute__((target("sse2")))
+static void escapeTimeRowSse2(const EscapeTimeRow &row, int *columns, int count,
+                              int startIteration, int maxIterations)
+{
+    const __m128d vCenterX = _mm_set1_pd(row.centerX);
+    const __m128d vScale = _mm_set1_pd(row.scaleFactor);
+    const __m128d vAy = _mm_set1_pd(row.ay);
+    const __m128d vLimit = _mm_set1_pd(Limit);
+    const __m128d vTwo = _mm_set1_pd(2.0);
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+
+    count = filterInterior(row, columns, count, startIteration);
+
+    int i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const int *c = columns + i;
+        const __m128d vAx = _mm_add_pd(vCenterX,
+                                       _mm_mul_pd(_mm_set_pd(row.x0 + c[1], row.x0 + c[0]), vScale));
+        __m128d a = vAx;
+        __m128d b = vAy;
+        if (startIteration > 0) {
+            a = _mm_set_pd(row.zr[c[1]], row.zr[c[0]]);
+            b = _mm_set_pd(row.zi[c[1]], row.zi[c[0]]);
+        }
+        __m128d active = _mm_castsi128_pd(_mm_set1_epi32(-1));
+        __m128d counts = _mm_set1_pd(maxIterations);
+
+        //--Brent 周期检测, 各通道起始迭代次数相同, 共用记录点
+        __m128d savedA = a;
+        __m128d savedB = b;
+        __m128d periodic = _mm_setzero_pd();
+        int checkpoint = startIteration + 1;
+        int window = 1;
+
+        for (int n = startIteration + 1; n <= maxIterations; ++n) {
+            __m128d a2 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)), vAx);
+            __m128d b2 = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(vTwo, a), b), vAy);
+            __m128d mag = _mm_add_pd(_mm_mul_pd(a2, a2), _mm_mul_pd(b2, b2));
+
+            //--本次迭代刚逃逸的通道记录迭代次数
+            __m128d escaped = _mm_and_pd(_mm_cmpgt_pd(mag, vLimit), active);
+            counts = _mm_or_pd(_mm_andnot_pd(escaped, counts),
+                               _mm_and_pd(escaped, _mm_set1_pd(n)));
+
+            //--只更新仍在迭代的通道
+            a = _mm_or_pd(_mm_andnot_pd(active, a), _mm_and_pd(active, a2));
+            b = _mm_or_pd(_mm_andnot_pd(active, b), _mm_and_pd(active, b2));
+            active = _mm_andnot_pd(escaped, active);
+
+            if (periodicity) {
+                __m128d cycle = _mm_and_pd(_mm_and_pd(_mm_cmpeq_pd(a, savedA), _mm_cmpeq_pd(b, savedB)),
+                                           active);
+                counts = _mm_or_pd(_mm_andnot_pd(cycle, counts),
+                                   _mm_and_pd(cycle, _mm_set1_pd(n)));
+                periodic = _mm_or_pd(periodic, cycle);
+                active = _mm_andnot_pd(cycle, active);
+
+                if (n == checkpoint) {
+                    savedA = a;
+                    savedB = b;
+                    window <<= 1;
+                    checkpoint += window;
+                }
+            }
+
+            if (_mm_movemask_pd(active) == 0)
+                break;
+        }
+
+        double la[2], lb[2], lc[2];
+        _mm_storeu_pd(la, a);
+        _mm_storeu_pd(lb, b);
+        _mm_storeu_pd(lc, counts);
+        storeLanes(row, c, 2, la, lb, lc, _mm_movemask_pd(active), _mm_movemask_pd(periodic));
+    }
+
+    //--不足一个向量的剩余像素
+    if (i < count)
+        escapeTimeColumnsScalar(row, columns + i, count - i, startIteration, maxIterations);
+}
+
+/*!
+ * \brief AVX2 版本, 4 路
+ */
+__attribute__((target("avx2")))
+static void escapeTimeRowAvx2(const EscapeTimeRow &row, int *columns, int count,
+                              int startIteration, int maxIterations)
+{
+    const __m256d vCenterX = _mm256_set1_pd(row.centerX);
+    const __m256d vScale = _mm256_set1_pd(row.scaleFactor);
+    const __m256d vAy = _mm256_set1_pd(row.ay);
+    const __m256d vLimit = _mm256_set1_pd(Limit);
+    const __m256d vTwo = _mm256_set1_pd(2.0);
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+
+    count = filterInterior(row, columns, count, startIteration);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const int *c = columns + i;
+        const __m256d vX = _mm256_set_pd(row.x0 + c[3], row.x0 + c[2], row.x0 + c[1], row.x0 + c[0]);
+        const __m256d vAx = _mm256_add_pd(vCenterX, _mm256_mul_pd(vX, vScale));
+        __m256d a = vAx;
+        __m256d b = vAy;
+        if (startIteration > 0) {
+            a = _mm256_set_pd(row.zr[c[3]], row.zr[c[2]], row.zr[c[1]], row.zr[c[0]]);
+            b = _mm256_set_pd(row.zi[c[3]], row.zi[c[2]], row.zi[c[1]], row.zi[c[0]]);
+        }
+        __m256d active = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        __m256d counts = _mm256_set1_pd(maxIterations);
+
+        __m256d savedA = a;
+        __m256d savedB = b;
+        __m256d periodic = _mm256_setzero_pd();
+        int checkpoint = startIteration + 1;
+        int window = 1;
+
+        for (int n = startIteration + 1; n <= maxIterations; ++n) {
+            __m256d a2 = _mm256_add_pd(_mm256_sub_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)), vAx);
+            __m256d b2 = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(vTwo, a), b), vAy);
+            __m256d mag = _mm256_add_pd(_mm256_mul_pd(a2, a2), _mm256_mul_pd(b2, b2));
+
+            __m256d escaped = _mm256_and_pd(_mm256_cmp_pd(mag, vLimit, _CMP_GT_OQ), active);
+            counts = _mm256_blendv_pd(counts, _mm256_set1_pd(n), escaped);
+
+            a = _mm256_blendv_pd(a, a2, active);
+            b = _mm256_blendv_pd(b, b2, active);
+            active = _mm256_andnot_pd(escaped, active);
+
+            if (periodicity) {
+                __m256d cycle = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(a, savedA, _CMP_EQ_OQ),
+                                                            _mm256_cmp_pd(b, savedB, _CMP_EQ_OQ)),
+                                              active);
+                counts = _mm256_blendv_pd(counts, _mm256_set1_pd(n), cycle);
+                periodic = _mm256_or_pd(periodic, cycle);
+                active = _mm256_andnot_pd(cycle, active);
+
+                if (n == checkpoint) {
+                    savedA = a;
+                    savedB = b;
+                    window <<= 1;
+                    checkpoint += window;
+                }
+            }
+
+            if (_mm256_movemask_pd(active) == 0)
+                break;
+        }
+
+        double la[4], lb[4], lc[4];
+        _mm256_storeu_pd(la, a);
+        _mm256_storeu_pd(lb, b);
+        _mm256_storeu_pd(lc, counts);
+        storeLanes(row, c, 4, la, lb, lc, _mm256_movemask_pd(active), _mm256_movemask_pd(periodic));
+    }
+
+    if (i < count)
+        escapeTimeColumnsScalar(row, columns + i, count - i, startIteration, maxIterations);
+}
+
+/*!
+ * \brief AVX-512 版本, 8 路, 逃逸判断直接得到掩码寄存器, 用 gather 装入
+ */
+__attribute__((target("avx512f")))
+static void escapeTimeRowAvx512(const EscapeTimeRow &row, int *columns, int count,
+                                int startIteration, int maxIterations)
+{
+    const __m512d vCenterX = _mm512_set1_pd(row.centerX);
+    const __m512d vScale = _mm512_set1_pd(row.scaleFactor);
+    const __m512d vAy = _mm512_set1_pd(row.ay);
+    const __m512d vLimit = _mm512_set1_pd(Limit);
+    const __m512d vTwo = _mm512_set1_pd(2.0);
+    const __m512d vX0 = _mm512_set1_pd(row.x0);
+
+    //--非掩码的 cvtepi32_pd / i32gather_pd / cvttpd_epi32 以未定义值为源操作数, GCC 12 报 -Wmaybe-uninitialized;
+    //--用全 1 掩码的版本, 源操作数取 0, 生成的指令相同
+    const __m512d vZero = _mm512_setzero_pd();
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+
+    count = filterInterior(row, columns, count, startIteration);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const int *c = columns + i;
+        const __m256i vColumns = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(c));
+        const __m512d vX = _mm512_add_pd(vX0, _mm512_mask_cvtepi32_pd(vZero, 0xff, vColumns));
+        const __m512d vAx = _mm512_add_pd(vCenterX, _mm512_mul_pd(vX, vScale));
+        __m512d a = vAx;
+        __m512d b = vAy;
+        if (startIteration > 0) {
+            a = _mm512_mask_i32gather_pd(vZero, 0xff, vColumns, row.zr, 8);
+            b = _mm512_mask_i32gather_pd(vZero, 0xff, vColumns, row.zi, 8);
+        }
+        __mmask8 active = 0xff;
+        __m512d counts = _mm512_set1_pd(maxIterations);
+
+        __m512d savedA = a;
+        __m512d savedB = b;
+        __mmask8 periodic = 0;
+        int checkpoint = startIteration + 1;
+        int window = 1;
+
+        for (int n = startIteration + 1; n <= maxIterations; ++n) {
+            __m512d a2 = _mm512_add_pd(_mm512_sub_pd(_mm512_mul_pd(a, a), _mm512_mul_pd(b, b)), vAx);
+            __m512d b2 = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(vTwo, a), b), vAy);
+            __m512d mag = _mm512_add_pd(_mm512_mul_pd(a2, a2), _mm512_mul_pd(b2, b2));
+
+            __mmask8 escaped = _mm512_mask_cmp_pd_mask(active, mag, vLimit, _CMP_GT_OQ);
+            counts = _mm512_mask_mov_pd(counts, escaped, _mm512_set1_pd(n));
+
+            a = _mm512_mask_mov_pd(a, active, a2);
+            b = _mm512_mask_mov_pd(b, active, b2);
+            active = active & ~escaped;
+
+            if (periodicity) {
+                __mmask8 cycle = _mm512_mask_cmp_pd_mask(active, a, savedA, _CMP_EQ_OQ)
+                        & _mm512_mask_cmp_pd_mask(active, b, savedB, _CMP_EQ_OQ);
+                counts = _mm512_mask_mov_pd(counts, cycle, _mm512_set1_pd(n));
+                periodic = periodic | cycle;
+                active = active & ~cycle;
+
+                if (n == checkpoint) {
+                    savedA = a;
+                    savedB = b;
+                    window <<= 1;
+                    checkpoint += window;
+                }
+            }
+
+            if (active == 0)
+                break;
+        }
+
+        _mm512_i32scatter_pd(row.zr, vColumns, a, 8);
+        _mm512_i32scatter_pd(row.zi, vColumns, b, 8);
+
+        //--迭代次数和状态是 32 位/8 位, AVX-512F 没有对应的 scatter, 逐通道写回
+        int lc[8];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lc), _mm512_mask_cvttpd_epi32(_mm256_setzero_si256(), 0xff, counts));
+        for (int lane = 0; lane < 8; ++lane) {
+            row.iterations[c[lane]] = lc[lane];
+            if (periodic & (1u << lane))
+                row.status[c[lane]] = PixelPeriodic;
+            else if (!(active & (1u << lane)))
+                row.status[c[lane]] = PixelEscaped;
+        }
+    }
+
+    if (i < count)
+        escapeTimeColumnsScalar(row, columns + i, count - i, startIteration, maxIterations);
+}
+
+#endif // MANDELBROT_X86_SIMD
+
+EscapeTimeRowFunction escapeTimeRowFunction(KernelIsa isa)
+{
+    switch (isa) {
+    case KernelScalar:
+        return escapeTimeRowScalar;
+#ifdef MANDELBROT_X86_SIMD
+    case KernelSse2:
+        return __builtin_cpu_supports("sse2") ? escapeTimeRowSse2 : nullptr;
+    case KernelAvx2:
+        return __builtin_cpu_supports("avx2") ? escapeTimeRowAvx2 : nullptr;
+    case KernelAvx512:
+        return __builtin_cpu_supports("avx512f") ? escapeTimeRowAvx512 : nullptr;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+KernelIsa detectKernelIsa()
+{
+    //--环境变量强制指定
+    const char *name = getenv("MANDELBROT_KERNEL");
+    if (name) {
+        for (int isa = 0; isa < KernelIsaCount; ++isa) {
+            if (strcmp(name, kernelIsaName(KernelIsa(isa))) == 0
+                    && escapeTimeRowFunction(KernelIsa(isa)))
+                return KernelIsa(isa);
+        }
+    }
+
+    //--从最宽的指令集开始找
+    for (int isa = KernelIsaCount - 1; isa > KernelScalar; --isa) {
+        if (escapeTimeRowFunction(KernelIsa(isa)))
+            return KernelIsa(isa);
+    }
+    return KernelScalar;
+}
+
+const char *kernelIsaName(KernelIsa isa)
+{
+    switch (isa) {
+    case KernelScalar:
+        return "scalar";
+    case KernelSse2:
+        return "sse2";
+    case KernelAvx2:
+        return "avx2";
+    case KernelAvx512:
+        return "avx512";
+    default:
+        return "unknown";
+    }
+}
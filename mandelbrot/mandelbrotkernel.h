@@ -0,0 +1,107 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   Mandelbrot 逃逸时间(escape-time)内核
+*
+*           Z(n+1)=(Zn)^2+C, 逐行计算每个像素的迭代次数
+*           每个像素的 z / 迭代次数 / 是否逃逸保存在迭代状态缓冲区中,
+*           下一轮(更大的最大迭代次数)只需从上一轮停下的地方继续未逃逸的像素.
+*           集合内部的点永不逃逸, 用主心形/周期 2 圆盘判定和 Brent 周期检测提前结束.
+*           标量版本与 SSE2(2路) / AVX2(4路) / AVX-512(8路) 向量版本,
+*           运行时通过 CPUID 选择当前 CPU 支持的最宽指令集.
+*           各版本运算顺序与标量完全相同(不使用 FMA 融合乘加),
+*           迭代次数与标量版本逐位一致.
+**********************************************************/
+
+#ifndef MANDELBROTKERNEL_H
+#define MANDELBROTKERNEL_H
+
+/*!
+ * \brief 内核指令集
+ */
+enum KernelIsa {
+    KernelScalar,
+    KernelSse2,
+    KernelAvx2,
+    KernelAvx512,
+    KernelIsaCount
+};
+
+/*!
+ * \brief 像素状态
+ */
+enum PixelStatus {
+    PixelUnresolved = 0,    //--尚未逃逸(未计算, 或达到上一轮的最大迭代次数)
+    PixelEscaped = 1,       //--已逃逸, 迭代次数不会再变化
+    PixelInsideBulb = 2,    //--在主心形或周期 2 圆盘内, 解析判定在集合内, 不迭代
+    PixelPeriodic = 3,      //--轨道出现周期(z 回到之前的值), 永不逃逸
+    PixelGlitched = 4       //--深度缩放: 扰动误差过大或参考轨道不够长, 需要换参考点重算
+};
+
+/*!
+ * \brief 内部点捷径, 可组合
+ */
+enum EscapeTimeOption {
+    EscapeTimeCardioid = 0x1,       //--首轮先做主心形 / 周期 2 圆盘判定
+    EscapeTimePeriodicity = 0x2     //--Brent 周期检测
+};
+
+/*!
+ * \brief 点 (x, y) 是否在主心形或周期 2 圆盘内(必在集合内)
+ */
+inline bool insideCardioidOrBulb(double x, double y)
+{
+    //--主心形: q(q + (x - 1/4)) < y^2/4, q = (x - 1/4)^2 + y^2
+    double xq = x - 0.25;
+    double q = (xq * xq) + (y * y);
+    if (q * (q + xq) < 0.25 * y * y)
+        return true;
+
+    //--周期 2 圆盘: 圆心 -1, 半径 1/4
+    return ((x + 1) * (x + 1)) + (y * y) < 0.0625;
+}
+
+/*!
+ * \brief 一行像素的迭代状态, 指针指向迭代状态缓冲区中该行第 0 列
+ *        第 i 列像素: 实部 ax = centerX + ((x0 + i) * scaleFactor), 虚部 ay
+ *        x0 为整数值, 用 double 保存, 分块缓存时是世界像素坐标, 可能超出 int 范围
+ */
+struct EscapeTimeRow
+{
+    double centerX;
+    double scaleFactor;
+    double ay;
+    double x0;
+    double *zr;                 //--当前 z 实部
+    double *zi;                 //--当前 z 虚部
+    int *iterations;            //--已迭代次数
+    unsigned char *status;      //--PixelStatus
+    int options;                //--EscapeTimeOption
+    double juliaX;              //--Julia 集的常数 K, 只用于 fractalkernel.h 的 Julia 内核
+    double juliaY;
+};
+
+/*!
+ * \brief 继续迭代一行中指定列的像素, 直到逃逸或达到 maxIterations
+ *        所列像素必须未逃逸且已迭代 startIteration 次; startIteration 为 0 时 z 从 C 开始,
+ *        否则从缓冲区中保存的 z 继续, 结果与从头迭代到 maxIterations 逐位一致
+ *        内部点捷径只把本来会迭代到上限的像素提前标记为内部, 逃逸像素不受影响
+ * \param columns 待迭代的列号, count 个(首轮做主心形判定时会被重排)
+ */
+typedef void (*EscapeTimeRowFunction)(const EscapeTimeRow &row, int *columns, int count,
+                                      int startIteration, int maxIterations);
+
+/*!
+ * \brief 指定指令集的内核, CPU 或编译器不支持时返回 nullptr
+ */
+EscapeTimeRowFunction escapeTimeRowFunction(KernelIsa isa);
+
+/*!
+ * \brief 当前 CPU 支持的最宽指令集
+ *        环境变量 MANDELBROT_KERNEL=scalar|sse2|avx2|avx512 可强制指定(用于对比和测试)
+ */
+KernelIsa detectKernelIsa();
+
+const char *kernelIsaName(KernelIsa isa);
+
+#endif // MANDELBROTKERNEL_H
@@ -50,6 +50,7 @@
 
 #include <QPainter>
 #include <QKeyEvent>
+#include <QStringList>
 
 #include <math.h>
 
@@ -69,18 +70,63 @@ const double ZoomInFactor = 0.8f;
 const double ZoomOutFactor = 1 / ZoomInFactor;
 
 const int ScrollStep = 20;
+
+/// \brief 循环变色: 每隔 CycleInterval 毫秒调色板偏移 CycleStep
+const int CycleInterval = 40;
+const int CycleStep = 4;
+
+/// \brief 输入到第一帧反馈的目标延迟(一个 60Hz 刷新周期)
+const double LatencyTargetMs = 16;
+
+/// \brief 帧预算模式('B' 键): 每帧最多算半个刷新周期, 只用一半 CPU 核
+const int FrameBudgetMs = 8;
+
+/// \brief 空闲推测('N' 键): 平移邻近区域向四周多算的像素
+const int SpeculationMargin = 128;
+
+/// \brief 各分形族的默认视图(中心, 缩放), 切换分形族时回到这里; Mandelbrot 同上
+struct FractalView
+{
+    double centerX;
+    double centerY;
+    double scale;
+};
+const FractalView DefaultViews[FractalFamilyCount] = {
+    { DefaultCenterX, DefaultCenterY, DefaultScale },
+    { 0.0, 0.0, 0.008 },
+    { 0.0, 0.0, 0.008 },
+    { -0.5, -0.5, 0.0075 }
+};
 //! [0]
 
 //! [1]
 MandelbrotWidget::MandelbrotWidget(QWidget *parent)
     : QWidget(parent)
 {
-    centerX = DefaultCenterX;
-    centerY = DefaultCenterY;
+    centerX = MpFloat(DefaultCenterX);
+    centerY = MpFloat(DefaultCenterY);
     pixmapScale = DefaultScale;
     curScale = DefaultScale;
-
-    connect(&thread, SIGNAL(renderedImage(QImage,double)), this, SLOT(updatePixmap(QImage,double)));
+    renderOptions = RenderThread::InteriorChecks | RenderThread::Preview | RenderThread::AdaptiveIterations
+            | RenderThread::ConjugateSymmetry;
+    showStatistics = false;
+    frameBudget = false;
+    palette = PaletteSpectrum;
+    colorOptions = 0;
+    colorOffset = 0;
+    frame = nullptr;
+    convertFrames = false;
+    acquireNs = 0;
+    convertNs = 0;
+    paintNs = 0;
+    inputClock.start();
+
+    thread.setOptions(renderOptions);
+    connect(&thread, SIGNAL(frameReady()), this, SLOT(updateFrame()));
+    connect(&thread, SIGNAL(renderFinished()), this, SLOT(updateSpeculation()));
+
+    //--'J' 键取光标处的点, 不按键时也要收到鼠标移动
+    setMouseTracking(true);
 
     setWindowTitle(tr("Mandelbrot"));
 #ifndef QT_NO_CURSOR
@@ -97,7 +143,7 @@ void MandelbrotWidget::paintEvent(QPaintEvent * /* event */)
     QPainter painter(this);
     painter.fillRect(rect(), Qt::black);
 
-    if (pixmap.isNull()) {
+    if (!frame || frame->image.isNull()) {
         painter.setPen(Qt::white);
         painter.drawText(rect(), Qt::AlignCenter, tr("Rendering initial image, please wait..."));
 //! [2] //! [3]
@@ -106,26 +152,38 @@ void MandelbrotWidget::paintEvent(QPaintEvent * /* event */)
     }
 //! [4]
 
+    //--RGB32 是光栅绘制引擎的原生格式, drawImage() 不需要转换
+    const QImage &image = frame->image;
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+
 //! [5]
     if (curScale == pixmapScale) {
 //! [5] //! [6]
-        painter.drawPixmap(pixmapOffset, pixmap);
+        if (convertFrames)
+            painter.drawPixmap(pixmapOffset, pixmap);
+        else
+            painter.drawImage(pixmapOffset, image);
 //! [6] //! [7]
     } else {
 //! [7] //! [8]
         double scaleFactor = pixmapScale / curScale;
-        int newWidth = int(pixmap.width() * scaleFactor);
-        int newHeight = int(pixmap.height() * scaleFactor);
-        int newX = pixmapOffset.x() + (pixmap.width() - newWidth) / 2;
-        int newY = pixmapOffset.y() + (pixmap.height() - newHeight) / 2;
+        int newWidth = int(image.width() * scaleFactor);
+        int newHeight = int(image.height() * scaleFactor);
+        int newX = pixmapOffset.x() + (image.width() - newWidth) / 2;
+        int newY = pixmapOffset.y() + (image.height() - newHeight) / 2;
 
         painter.save();
         painter.translate(newX, newY);
         painter.scale(scaleFactor, scaleFactor);
         QRectF exposed = painter.matrix().inverted().mapRect(rect()).adjusted(-1, -1, 1, 1);
-        painter.drawPixmap(exposed, pixmap, exposed);
+        if (convertFrames)
+            painter.drawPixmap(exposed, pixmap, exposed);
+        else
+            painter.drawImage(exposed, image, exposed);
         painter.restore();
     }
+    paintNs = paintTimer.nsecsElapsed();
 //! [8] //! [9]
 
     QString text = tr("Use mouse wheel or the '+' and '-' keys to zoom. "
@@ -138,9 +196,108 @@ void MandelbrotWidget::paintEvent(QPaintEvent * /* event */)
     painter.drawRect((width() - textWidth) / 2 - 5, 0, textWidth + 10, metrics.lineSpacing() + 5);
     painter.setPen(Qt::white);
     painter.drawText((width() - textWidth) / 2, metrics.leading() + metrics.ascent(), text);
+
+    if (showStatistics)
+        drawStatistics(painter);
 }
 //! [9]
 
+/*!
+ * \brief 在图像底部显示当前渲染请求的统计
+ */
+void MandelbrotWidget::drawStatistics(QPainter &painter)
+{
+    RenderThread::Statistics stats = thread.statistics();
+    TileCache::Counters cache = thread.tileCacheCounters();
+
+    QStringList lines;
+
+    //--逐轮全图扫描需要迭代 pixels * passes 个像素
+    lines << tr("pass %1 (max %2): %3 ms, iterated %4 of %5 pixels, %6 iterations")
+             .arg(stats.passes).arg(stats.maxIterations).arg(stats.elapsedMs)
+             .arg(stats.iteratedPixels).arg(stats.pixels * stats.passes).arg(stats.iterations);
+    lines << tr("adaptive iterations %1: about %2 iterations saved")
+             .arg(onOff(RenderThread::AdaptiveIterations)).arg(stats.savedIterations);
+    lines << tr("preview %1: %2 low-resolution frames, first frame after %3 ms")
+             .arg(onOff(RenderThread::Preview)).arg(stats.previewLevels).arg(stats.firstFrameMs);
+    lines << tr("interior checks %1: bulb %2, periodic %3; Mariani-Silver %4: filled %5")
+             .arg(onOff(RenderThread::InteriorChecks)).arg(stats.bulbPixels).arg(stats.periodicPixels)
+             .arg(onOff(RenderThread::MarianiSilver)).arg(stats.filledPixels);
+    lines << tr("conjugate symmetry %1: mirrored %2 pixels")
+             .arg(onOff(RenderThread::ConjugateSymmetry)).arg(stats.mirroredPixels);
+    lines << tr("tile cache %1: %2 hits / %3 misses this view; total %4 hits, %5 disk hits, "
+                "%6 misses, %7 tiles (%8 MB)")
+             .arg(onOff(RenderThread::TileCaching)).arg(stats.cacheHits).arg(stats.cacheMisses)
+             .arg(cache.hits).arg(cache.diskHits).arg(cache.misses).arg(cache.tiles)
+             .arg(cache.bytes / (1024 * 1024));
+    lines << tr("fractal %1 (T), exponent %2 (D), Julia K = %3 %4 %5i (J: point under cursor)")
+             .arg(fractalFamilyName(fractal.family)).arg(fractal.exponent)
+             .arg(fractal.juliaX, 0, 'g', 6).arg(fractal.juliaY < 0 ? QString("-") : QString("+"))
+             .arg(qAbs(fractal.juliaY), 0, 'g', 6);
+    lines << tr("kernel %1 / %2 (deep zoom %3): scale %4, %5 references, %6 glitched pixels")
+             .arg(kernelIsaName(stats.isa)).arg(precisionName(stats.precision))
+             .arg(onOff(RenderThread::DeepZoom)).arg(curScale, 0, 'g', 3)
+             .arg(stats.references).arg(stats.glitchedPixels);
+    lines << tr("palette %1 (1-4), smooth %2, equalize %3, cycling %4: colorized in %5 us")
+             .arg(paletteName(palette))
+             .arg((colorOptions & ColorSmooth) ? tr("on") : tr("off"))
+             .arg((colorOptions & ColorEqualize) ? tr("on") : tr("off"))
+             .arg(cycleTimer.isActive() ? tr("on") : tr("off")).arg(stats.colorNs / 1000);
+    RenderThread::SpeculationCounters speculation = thread.speculationCounters();
+    qint64 lookups = speculation.viewHits + speculation.viewMisses;
+    lines << tr("speculation %1: %2 views (%3 preempted), %4 tiles prefetched; "
+                "view tile lookups %5 hits / %6 misses (%7% hits)")
+             .arg(onOff(RenderThread::Speculation)).arg(speculation.views).arg(speculation.preempted)
+             .arg(speculation.tiles).arg(speculation.viewHits).arg(speculation.viewMisses)
+             .arg(lookups > 0 ? 100 * speculation.viewHits / lookups : 0);
+    lines << tr("frame budget %1: %2 deadline frames, interval %3 us (jitter %4 us, max %5 us), CPU %6%")
+             .arg(frameBudget ? tr("%1 ms").arg(FrameBudgetMs) : tr("off")).arg(stats.budgetFrames)
+             .arg(stats.frameIntervalUs).arg(stats.frameJitterUs).arg(stats.maxFrameIntervalUs)
+             .arg(stats.cpuPercent);
+    FrameRing::Counters ring = thread.frameRing()->counters();
+    lines << tr("frame handoff (%1): render %2 us, acquire %3 us, convert %4 us, paint %5 us; "
+                "%6 published, %7 shown, %8 dropped, %9 allocations")
+             .arg(convertFrames ? tr("QPixmap::fromImage") : tr("zero-copy"))
+             .arg(stats.handoffNs / 1000).arg(acquireNs / 1000).arg(convertNs / 1000).arg(paintNs / 1000)
+             .arg(ring.published).arg(ring.acquired).arg(ring.dropped).arg(ring.allocations);
+    if (latency.samples > 0) {
+        lines << tr("input to frame: %1 samples, last %2 ms, p50 < %3 ms, p95 < %4 ms, max %5 ms, "
+                    "%6% under %7 ms")
+                 .arg(latency.samples).arg(latency.lastMs, 0, 'f', 1)
+                 .arg(latency.percentile(0.5)).arg(latency.percentile(0.95))
+                 .arg(latency.maxMs, 0, 'f', 1).arg(100 * latency.underTarget / latency.samples)
+                 .arg(LatencyTargetMs);
+        QString buckets;
+        for (int i = 0; i < LatencyHistogram::Buckets; ++i) {
+            buckets += i + 1 < LatencyHistogram::Buckets
+                    ? QString(" <%1: %2").arg(1 << i).arg(latency.counts[i])
+                    : QString(" >=%1: %2").arg(1 << (i - 1)).arg(latency.counts[i]);
+        }
+        lines << tr("latency histogram (ms):%1").arg(buckets);
+    }
+
+    QFontMetrics metrics = painter.fontMetrics();
+    int textWidth = 0;
+    for (const QString &line : lines)
+        textWidth = qMax(textWidth, metrics.horizontalAdvance(line));
+    int top = height() - lines.size() * metrics.lineSpacing() - 5;
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 0, 0, 127));
+    painter.drawRect((width() - textWidth) / 2 - 5, top,
+                     textWidth + 10, lines.size() * metrics.lineSpacing() + 5);
+    painter.setPen(Qt::white);
+    for (const QString &line : lines) {
+        painter.drawText((width() - textWidth) / 2, top + metrics.leading() + metrics.ascent(), line);
+        top += metrics.lineSpacing();
+    }
+}
+
+QString MandelbrotWidget::onOff(int option) const
+{
+    return (renderOptions & option) ? tr("on") : tr("off");
+}
+
 //! [10]
 void MandelbrotWidget::resizeEvent(QResizeEvent * /* event */)
 {
@@ -170,6 +327,98 @@ void MandelbrotWidget::keyPressEvent(QKeyEvent *event)
     case Qt::Key_Up:
         scroll(0, +ScrollStep);
         break;
+    case Qt::Key_I://--内部点捷径开关, 对比耗时
+        toggleOption(RenderThread::InteriorChecks);
+        break;
+    case Qt::Key_M://--Mariani-Silver / 逐行扫描切换, 对比实际迭代的像素数
+        toggleOption(RenderThread::MarianiSilver);
+        break;
+    case Qt::Key_A://--自适应最大迭代次数开关, 对比轮数和耗时
+        toggleOption(RenderThread::AdaptiveIterations);
+        break;
+    case Qt::Key_Y://--共轭对称开关, 视图跨过实轴时对比耗时
+        toggleOption(RenderThread::ConjugateSymmetry);
+        break;
+    case Qt::Key_N://--空闲推测开关; 推测结果放在分块缓存中, 打开时一并打开分块缓存
+        if (!(renderOptions & RenderThread::Speculation))
+            renderOptions |= RenderThread::TileCaching;
+        toggleOption(RenderThread::Speculation);
+        break;
+    case Qt::Key_L://--低分辨率预览开关, 对比第一帧耗时
+        toggleOption(RenderThread::Preview);
+        break;
+    case Qt::Key_C://--分块缓存开关
+        toggleOption(RenderThread::TileCaching);
+        break;
+    case Qt::Key_P://--浅缩放时也强制微扰计算, 与直接计算对比
+        toggleOption(RenderThread::DeepZoom);
+        break;
+    case Qt::Key_B://--帧预算模式开关: 按时发布部分结果, 不占满 CPU
+        frameBudget = !frameBudget;
+        thread.setFrameBudget(frameBudget ? FrameBudgetMs : 0, qMax(1, QThread::idealThreadCount() / 2));
+        thread.render(centerX, centerY, curScale, size());
+        break;
+    case Qt::Key_T://--切换分形族: Mandelbrot / Julia / Multibrot / Burning Ship
+        {
+            Fractal selected = fractal;
+            selected.family = FractalFamily((fractal.family + 1) % FractalFamilyCount);
+            selectFractal(selected);
+        }
+        break;
+    case Qt::Key_D://--Multibrot 的幂次 3..8 循环, 不是 Multibrot 时切换过去
+        {
+            Fractal selected = fractal;
+            if (fractal.family == FractalMultibrot)
+                selected.exponent = fractal.exponent < MaxMultibrotExponent
+                        ? fractal.exponent + 1 : int(MinMultibrotExponent);
+            selected.family = FractalMultibrot;
+            selectFractal(selected);
+        }
+        break;
+    case Qt::Key_J://--光标处的点作 Julia 集的常数 K(限制 |K| <= 2, 逃逸半径 2 才成立), 切换到 Julia 集
+        {
+            QPoint pos = rect().contains(cursorPos) ? cursorPos : rect().center();
+            Fractal selected = fractal;
+            selected.family = FractalJulia;
+            selected.juliaX = (centerX + MpFloat((pos.x() - width() / 2) * curScale)).toDouble();
+            selected.juliaY = (centerY + MpFloat((pos.y() - height() / 2) * curScale)).toDouble();
+            double magnitude = sqrt((selected.juliaX * selected.juliaX) + (selected.juliaY * selected.juliaY));
+            if (magnitude > 2) {
+                selected.juliaX *= 2 / magnitude;
+                selected.juliaY *= 2 / magnitude;
+            }
+            selectFractal(selected);
+        }
+        break;
+    case Qt::Key_F://--帧交接: 直接绘制 / 每帧转换为 QPixmap, 对比耗时
+        convertFrames = !convertFrames;
+        pixmap = (frame && convertFrames) ? QPixmap::fromImage(frame->image) : QPixmap();
+        update();
+        break;
+    case Qt::Key_1://--调色板, 只重新上色, 不重新迭代
+    case Qt::Key_2:
+    case Qt::Key_3:
+    case Qt::Key_4:
+        palette = Palette(event->key() - Qt::Key_1);
+        thread.setPalette(palette);
+        break;
+    case Qt::Key_G://--平滑着色开关
+        toggleColorOption(ColorSmooth);
+        break;
+    case Qt::Key_E://--直方图均衡开关
+        toggleColorOption(ColorEqualize);
+        break;
+    case Qt::Key_R://--循环变色开关
+        if (cycleTimer.isActive())
+            cycleTimer.stop();
+        else
+            cycleTimer.start(CycleInterval, this);
+        update();
+        break;
+    case Qt::Key_S://--统计显示开关
+        showStatistics = !showStatistics;
+        update();
+        break;
     default:
         QWidget::keyPressEvent(event);
     }
@@ -198,6 +447,8 @@ void MandelbrotWidget::mousePressEvent(QMouseEvent *event)
 //! [14]
 void MandelbrotWidget::mouseMoveEvent(QMouseEvent *event)
 {
+    cursorPos = event->pos();
+
     if (event->buttons() & Qt::LeftButton) {
 
         //--拖动偏移
@@ -223,33 +474,139 @@ void MandelbrotWidget::mouseReleaseEvent(QMouseEvent *event)
         //--清空拖到的位置
         lastDragPos = QPoint();
 
-        int deltaX = (width() - pixmap.width()) / 2 - pixmapOffset.x();
-        int deltaY = (height() - pixmap.height()) / 2 - pixmapOffset.y();
+        if (!frame)
+            return;
+
+        int deltaX = (width() - frame->image.width()) / 2 - pixmapOffset.x();
+        int deltaY = (height() - frame->image.height()) / 2 - pixmapOffset.y();
         scroll(deltaX, deltaY);
     }
 }
 //! [15]
 
 //! [16]
-void MandelbrotWidget::updatePixmap(const QImage &image, double scaleFactor)
+void MandelbrotWidget::updateFrame()
 {
+    //--拖动中不取新帧, 已发布的帧留在帧环里, 松开后取最新一帧
     if (!lastDragPos.isNull())
         return;
 
-    pixmap = QPixmap::fromImage(image);
+    //--连续多个通知时第一次就取到了最新帧, 之后的 acquire() 返回同一帧
+    QElapsedTimer handoffTimer;
+    handoffTimer.start();
+    frame = thread.frameRing()->acquire();
+    acquireNs = handoffTimer.nsecsElapsed();
+
+    if (convertFrames) {
+        handoffTimer.start();
+        pixmap = QPixmap::fromImage(frame->image);
+        convertNs = handoffTimer.nsecsElapsed();
+    } else {
+        convertNs = 0;
+    }
+
+    //--反映了这些缩放/滚动的第一帧
+    qint64 now = inputClock.nsecsElapsed();
+    int answered = 0;
+    while (answered < pendingInputs.size() && pendingInputs[answered].request <= frame->request) {
+        latency.add((now - pendingInputs[answered].timeNs) * 1e-6);
+        ++answered;
+    }
+    pendingInputs.remove(0, answered);
+
     pixmapOffset = QPoint();
     lastDragPos = QPoint();
-    pixmapScale = scaleFactor;
+    pixmapScale = frame->scaleFactor;
     update();
 }
 //! [16]
 
+/*!
+ * \brief 空闲推测的视图: 与 zoom() 相同以视图中心放大一级(ZoomInFactor), 当前缩放下向四周扩大 SpeculationMargin 的平移邻近区域
+ */
+void MandelbrotWidget::updateSpeculation()
+{
+    if (!(renderOptions & RenderThread::Speculation))
+        return;
+
+    QVector<RenderThread::SpeculativeView> views;
+
+    RenderThread::SpeculativeView zoomIn;
+    zoomIn.centerX = centerX;
+    zoomIn.centerY = centerY;
+    zoomIn.scaleFactor = curScale * ZoomInFactor;
+    zoomIn.size = size();
+    views << zoomIn;
+
+    RenderThread::SpeculativeView pan;
+    pan.centerX = centerX;
+    pan.centerY = centerY;
+    pan.scaleFactor = curScale;
+    pan.size = size() + QSize(2 * SpeculationMargin, 2 * SpeculationMargin);
+    pan.viewSize = size();
+    views << pan;
+
+    thread.setSpeculativeViews(views);
+}
+
+/*!
+ * \brief 切换一个渲染选项, 以当前视图重新渲染
+ * \param option RenderThread::RenderOption
+ */
+void MandelbrotWidget::toggleOption(int option)
+{
+    renderOptions ^= option;
+    thread.setOptions(renderOptions);
+    thread.render(centerX, centerY, curScale, size());
+}
+
+/*!
+ * \brief 渲染另一个分形; 分形族改变时视图回到该分形族的默认位置
+ */
+void MandelbrotWidget::selectFractal(const Fractal &selected)
+{
+    if (selected.family != fractal.family) {
+        const FractalView &view = DefaultViews[selected.family];
+        centerX = MpFloat(view.centerX);
+        centerY = MpFloat(view.centerY);
+        curScale = view.scale;
+    }
+    fractal = selected;
+    thread.setFractal(fractal);
+    update();
+    requestRender();
+}
+
+/*!
+ * \brief 切换一个上色选项, 渲染线程用已有的迭代状态重新上色
+ * \param option ColorOption
+ */
+void MandelbrotWidget::toggleColorOption(int option)
+{
+    colorOptions ^= option;
+    thread.setColorOptions(colorOptions);
+}
+
+/*!
+ * \brief 循环变色: 调色板偏移前进一步
+ */
+void MandelbrotWidget::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != cycleTimer.timerId()) {
+        QWidget::timerEvent(event);
+        return;
+    }
+
+    colorOffset = (colorOffset + CycleStep) % PaletteSize;
+    thread.setColorOffset(colorOffset);
+}
+
 //! [17]
 void MandelbrotWidget::zoom(double zoomFactor)
 {
     curScale *= zoomFactor;
     update();
-    thread.render(centerX, centerY, curScale, size());
+    requestRender();
 }
 //! [17]
 
@@ -257,9 +614,49 @@ void MandelbrotWidget::zoom(double zoomFactor)
 //! \brief 滚动
 void MandelbrotWidget::scroll(int deltaX, int deltaY)
 {
-    centerX += deltaX * curScale;
-    centerY += deltaY * curScale;
+    centerX += MpFloat(deltaX * curScale);
+    centerY += MpFloat(deltaY * curScale);
     update();
-    thread.render(centerX, centerY, curScale, size());
+    requestRender();
 }
 //! [18]
+
+/*!
+ * \brief 缩放/滚动: 请求渲染当前视图, 记下时刻, 统计到第一帧的延迟
+ */
+void MandelbrotWidget::requestRender()
+{
+    PendingInput input;
+    input.timeNs = inputClock.nsecsElapsed();
+    input.request = thread.render(centerX, centerY, curScale, size());
+    pendingInputs.append(input);
+}
+
+MandelbrotWidget::LatencyHistogram::LatencyHistogram()
+    : samples(0), underTarget(0), lastMs(0), maxMs(0)
+{
+    for (int i = 0; i < Buckets; ++i)
+        counts[i] = 0;
+}
+
+void MandelbrotWidget::LatencyHistogram::add(double ms)
+{
+    int bucket = ms < 1 ? 0 : qMin(int(Buckets) - 1, 1 + int(log2(ms)));
+    ++counts[bucket];
+    ++samples;
+    if (ms < LatencyTargetMs)
+        ++underTarget;
+    lastMs = ms;
+    maxMs = qMax(maxMs, ms);
+}
+
+double MandelbrotWidget::LatencyHistogram::percentile(double fraction) const
+{
+    int seen = 0;
+    for (int i = 0; i + 1 < Buckets; ++i) {
+        seen += counts[i];
+        if (seen >= fraction * samples)
+            return 1 << i;
+    }
+    return maxMs;
+}
@@ -51,8 +51,16 @@
 #ifndef MANDELBROTWIDGET_H
 #define MANDELBROTWIDGET_H
 
+#include <QBasicTimer>
+#include <QElapsedTimer>
 #include <QPixmap>
+#include <QVector>
 #include <QWidget>
+
+QT_BEGIN_NAMESPACE
+class QPainter;
+QT_END_NAMESPACE
+
 #include "renderthread.h"
 
 
@@ -74,22 +82,97 @@ protected:
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void timerEvent(QTimerEvent *event) override;
 
 private slots:
-    void updatePixmap(const QImage &image, double scaleFactor);
+    void updateFrame();
+    void updateSpeculation();
     void zoom(double zoomFactor);
 
 private:
+    /*!
+     * \brief 输入到第一帧的延迟直方图, 按 2 的幂毫秒分桶: [0,1) [1,2) [2,4) ... [256,∞)
+     */
+    struct LatencyHistogram
+    {
+        enum { Buckets = 10 };
+
+        int counts[Buckets];
+        int samples;
+        int underTarget;            //--低于 LatencyTargetMs 的样本
+        double lastMs;
+        double maxMs;
+
+        LatencyHistogram();
+        void add(double ms);
+
+        /*!
+         * \brief 至少 fraction 的样本所在桶的上界(毫秒), 最后一个桶取最大值
+         */
+        double percentile(double fraction) const;
+    };
+
     void scroll(int deltaX, int deltaY);
+    void requestRender();
+    void toggleOption(int option);
+    void toggleColorOption(int option);
+    void selectFractal(const Fractal &selected);
+    void drawStatistics(QPainter &painter);
+    QString onOff(int option) const;
 
     RenderThread thread;
+
+    ///--从帧环取得的当前帧(Format_RGB32, 直接绘制), 在下一次 acquire() 之前有效
+    const FrameRing::Frame *frame;
+
+    ///--对比用的旧路径: 每帧 QPixmap::fromImage() 转换后绘制('F' 键切换)
     QPixmap pixmap;
+    bool convertFrames;
+
+    ///--最近一帧的交接耗时: 取帧 / 转换(仅旧路径) / 绘制
+    qint64 acquireNs;
+    qint64 convertNs;
+    qint64 paintNs;
+
+    ///--缩放/滚动发出的渲染请求序号与时刻(inputClock 纳秒), 收到反映它的第一帧时记入 latency
+    struct PendingInput
+    {
+        qint64 request;
+        qint64 timeNs;
+    };
+    QVector<PendingInput> pendingInputs;
+    QElapsedTimer inputClock;
+    LatencyHistogram latency;
+
     QPoint pixmapOffset;
     QPoint lastDragPos;
-    double centerX;
-    double centerY;
+
+    ///--中心用多精度保存, 深度缩放时每次滚动的偏移远小于 double 的分辨率
+    MpFloat centerX;
+    MpFloat centerY;
     double pixmapScale;
     double curScale;
+
+    ///--RenderThread::RenderOption
+    int renderOptions;
+
+    ///--是否在图像底部显示渲染统计('S' 键切换)
+    bool showStatistics;
+
+    ///--帧预算模式('B' 键切换)
+    bool frameBudget;
+
+    ///--光标位置('J' 键取 Julia 集的常数)
+    QPoint cursorPos;
+
+    ///--分形: 'T' 切换分形族, 'D' Multibrot 的幂次, 'J' 光标处的点作 Julia 集的常数
+    Fractal fractal;
+
+    ///--上色: 调色板('1'-'4'), ColorOption('G' 平滑 / 'E' 直方图均衡), 循环变色('R')的偏移和定时器
+    Palette palette;
+    int colorOptions;
+    int colorOffset;
+    QBasicTimer cycleTimer;
 };
 //! [0]
 
@@ -0,0 +1,197 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   软件多精度定点数
+**********************************************************/
+
+#include "mpfloat.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+
+MpFloat::MpFloat()
+{
+    for (int i = 0; i < Limbs; ++i)
+        limb[i] = 0;
+}
+
+MpFloat::MpFloat(double value)
+{
+    bool negative = value < 0;
+    double magnitude = fabs(value);
+
+    //--整数部分, 之后每次把小数部分放大 2^32 取出一个字; 乘 2 的幂和减去整数都是精确的
+    double whole = floor(magnitude);
+    limb[Limbs - 1] = uint32_t(whole);
+    magnitude -= whole;
+
+    for (int i = Limbs - 2; i >= 0; --i) {
+        magnitude = ldexp(magnitude, 32);
+        whole = floor(magnitude);
+        limb[i] = uint32_t(whole);
+        magnitude -= whole;
+    }
+
+    if (negative)
+        *this = -*this;
+}
+
+MpFloat MpFloat::fromString(const char *text, bool *ok)
+{
+    const char *p = text;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+')
+        ++p;
+
+    //--整数部分逐位累加: v = v * 10 + d, 都是精确的; 超出整数部分的范围时格式错误
+    MpFloat value;
+    bool inRange = true;
+    int digits = 0;
+    for (; isdigit((unsigned char)*p); ++p, ++digits)
+        inRange = inRange && value.multiplyByTen(uint32_t(*p - '0'));
+
+    //--小数部分从最后一位往前: f = (f + d) / 10, 每位只有一次截断
+    if (*p == '.') {
+        const char *first = ++p;
+        while (isdigit((unsigned char)*p))
+            ++p;
+        digits += int(p - first);
+
+        MpFloat fraction;
+        for (const char *q = p; q != first; --q)
+            fraction = (fraction + MpFloat(double(q[-1] - '0'))).dividedBy(10);
+        value += fraction;
+    }
+
+    if (*p == 'e' || *p == 'E') {
+        char *end = nullptr;
+        long exponent = strtol(p + 1, &end, 10);
+        if (end == p + 1) {
+            digits = 0;
+        } else {
+            p = end;
+
+            //--非零值最多乘约 80 次就超出范围, 最多除约 70 次就截断为 0, 之后不再变化
+            const MpFloat zero;
+            for (; exponent > 0 && inRange && value != zero; --exponent)
+                inRange = value.multiplyByTen(0);
+            for (; exponent < 0 && value != zero; ++exponent)
+                value = value.dividedBy(10);
+        }
+    }
+
+    bool valid = digits > 0 && *p == '\0' && inRange;
+    if (ok)
+        *ok = valid;
+    if (!valid)
+        return MpFloat();
+    return negative ? -value : value;
+}
+
+/*!
+ * \brief 非负数乘 10 再加一位数字 digit
+ * \return 结果超出整数部分的范围(>= 2^31)时返回 false
+ */
+bool MpFloat::multiplyByTen(uint32_t digit)
+{
+    //--整数部分不超过 (2^31 - 1) / 10 时结果小于 2^32, 是否越过 2^31 看符号位
+    if (limb[Limbs - 1] > 0x7fffffffu / 10)
+        return false;
+    *this = *this * MpFloat(10.0) + MpFloat(double(digit));
+    return !isNegative();
+}
+
+/*!
+ * \brief 除以小整数: 绝对值从最高字往下做竖式除法, 截断
+ */
+MpFloat MpFloat::dividedBy(uint32_t divisor) const
+{
+    MpFloat magnitude = isNegative() ? -*this : *this;
+
+    uint64_t remainder = 0;
+    for (int i = Limbs - 1; i >= 0; --i) {
+        uint64_t current = (remainder << 32) | magnitude.limb[i];
+        magnitude.limb[i] = uint32_t(current / divisor);
+        remainder = current % divisor;
+    }
+
+    return isNegative() ? -magnitude : magnitude;
+}
+
+double MpFloat::toDouble() const
+{
+    MpFloat magnitude = isNegative() ? -*this : *this;
+
+    //--从低位往高位累加, 高位最后加入, 舍入误差最小
+    double value = 0;
+    for (int i = 0; i < Limbs; ++i)
+        value += ldexp(double(magnitude.limb[i]), 32 * (i - (Limbs - 1)));
+
+    return isNegative() ? -value : value;
+}
+
+MpFloat MpFloat::operator+(const MpFloat &other) const
+{
+    MpFloat result;
+    uint64_t carry = 0;
+    for (int i = 0; i < Limbs; ++i) {
+        uint64_t sum = uint64_t(limb[i]) + other.limb[i] + carry;
+        result.limb[i] = uint32_t(sum);
+        carry = sum >> 32;
+    }
+    return result;
+}
+
+MpFloat MpFloat::operator-(const MpFloat &other) const
+{
+    return *this + (-other);
+}
+
+MpFloat MpFloat::operator-() const
+{
+    //--补码取负: 按位取反加一
+    MpFloat result;
+    uint64_t carry = 1;
+    for (int i = 0; i < Limbs; ++i) {
+        uint64_t sum = uint64_t(uint32_t(~limb[i])) + carry;
+        result.limb[i] = uint32_t(sum);
+        carry = sum >> 32;
+    }
+    return result;
+}
+
+/*!
+ * \brief 乘法: 绝对值做 Limbs x Limbs 字的竖式乘法, 取积的中间 Limbs 个字(截断), 再恢复符号, 即向零舍入
+ */
+MpFloat MpFloat::operator*(const MpFloat &other) const
+{
+    MpFloat a = isNegative() ? -*this : *this;
+    MpFloat b = other.isNegative() ? -other : other;
+
+    uint32_t product[2 * Limbs] = {};
+    for (int i = 0; i < Limbs; ++i) {
+        uint64_t carry = 0;
+        for (int j = 0; j < Limbs; ++j) {
+            uint64_t t = uint64_t(a.limb[i]) * b.limb[j] + product[i + j] + carry;
+            product[i + j] = uint32_t(t);
+            carry = t >> 32;
+        }
+        product[i + Limbs] = uint32_t(carry);
+    }
+
+    MpFloat result;
+    for (int i = 0; i < Limbs; ++i)
+        result.limb[i] = product[i + Limbs - 1];
+
+    return isNegative() != other.isNegative() ? -result : result;
+}
+
+bool MpFloat::operator==(const MpFloat &other) const
+{
+    for (int i = 0; i < Limbs; ++i) {
+        if (limb[i] != other.limb[i])
+            return false;
+    }
+    return true;
+}
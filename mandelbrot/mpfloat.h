@@ -0,0 +1,59 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   软件多精度定点数, 用于深度缩放的中心坐标和参考轨道
+*
+*           Limbs 个 32 位字, 二进制补码, 最高字为整数部分(含符号),
+*           其余为小数部分: 224 位小数, 约 67 位十进制有效数字.
+*           只实现 Mandelbrot 迭代需要的加、减、乘, 乘法截断绝对值再恢复符号(向零舍入, 正负对称).
+**********************************************************/
+
+#ifndef MPFLOAT_H
+#define MPFLOAT_H
+
+#include <stdint.h>
+
+class MpFloat
+{
+public:
+    /// \brief 字数, limb[Limbs - 1] 为整数部分, limb[0] 为最低位
+    enum { Limbs = 8 };
+
+    /// \brief 小数位数
+    enum { FractionBits = 32 * (Limbs - 1) };
+
+    MpFloat();
+
+    /*!
+     * \brief 由 double 精确转换(|value| < 2^31)
+     */
+    explicit MpFloat(double value);
+
+    /*!
+     * \brief 由十进制字符串转换, 如 "-0.7436438870371587522", "1.5e-20";
+     *        有效数字不受 double 限制(深度缩放的中心坐标). 格式错误或 |值| >= 2^31 时 ok 为 false, 返回 0
+     */
+    static MpFloat fromString(const char *text, bool *ok = nullptr);
+
+    double toDouble() const;
+
+    bool isNegative() const { return int32_t(limb[Limbs - 1]) < 0; }
+
+    MpFloat operator+(const MpFloat &other) const;
+    MpFloat operator-(const MpFloat &other) const;
+    MpFloat operator*(const MpFloat &other) const;
+    MpFloat operator-() const;
+
+    MpFloat &operator+=(const MpFloat &other) { return *this = *this + other; }
+
+    bool operator==(const MpFloat &other) const;
+    bool operator!=(const MpFloat &other) const { return !(*this == other); }
+
+private:
+    MpFloat dividedBy(uint32_t divisor) const;
+    bool multiplyByTen(uint32_t digit);
+
+    uint32_t limb[Limbs];
+};
+
+#endif // MPFLOAT_H
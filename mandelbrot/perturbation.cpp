@@ -0,0 +1,132 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   深度缩放: 参考轨道与微扰内核
+**********************************************************/
+
+#include "perturbation.h"
+
+#include "mandelbrotkernel.h"
+
+/// \brief 幅值 Limit = 2^2 = 4, 与逃逸时间内核相同
+static const double Limit = 4;
+
+/// \brief Pauldelbrot 判据: |Z + δz|^2 < GlitchTolerance * |Z|^2 时视为失真(|z| 小于 |Z| 的 1/1000)
+static const double GlitchTolerance = 1e-6;
+
+ReferenceOrbit::ReferenceOrbit()
+    : escaped(false)
+{
+}
+
+void ReferenceOrbit::reset(const MpFloat &centerX, const MpFloat &centerY)
+{
+    cx = centerX;
+    cy = centerY;
+    zx = centerX;
+    zy = centerY;
+    escaped = false;
+
+    orbitX.assign(1, centerX.toDouble());
+    orbitY.assign(1, centerY.toDouble());
+}
+
+void ReferenceOrbit::extend(int maxIterations)
+{
+    if (length() >= maxIterations)
+        return;
+
+    orbitX.reserve(maxIterations + 1);
+    orbitY.reserve(maxIterations + 1);
+
+    while (!escaped && length() < maxIterations) {
+
+        //-- Z(n+1)=(Zn)^2+C, 每次 3 个多精度乘法
+        MpFloat xx = zx * zx;
+        MpFloat yy = zy * zy;
+        MpFloat xy = zx * zy;
+        zx = xx - yy + cx;
+        zy = xy + xy + cy;
+
+        double x = zx.toDouble();
+        double y = zy.toDouble();
+        orbitX.push_back(x);
+        orbitY.push_back(y);
+
+        //--逃逸后继续平方会超出定点数整数部分的范围
+        if ((x * x) + (y * y) > Limit)
+            escaped = true;
+    }
+}
+
+/*!
+ * \brief 微扰迭代一个像素
+ */
+static inline void perturbationPixel(const PerturbationRow &row, int column,
+                                     int startIteration, int maxIterations)
+{
+    const double *referenceX = row.referenceX;
+    const double *referenceY = row.referenceY;
+
+    double dcx = (row.x0 + column) * row.scaleFactor;
+    double dcy = row.dcy;
+
+    //--z(0) = c, Z(0) = C, δz(0) = δc
+    double dx = dcx;
+    double dy = dcy;
+    if (startIteration > 0) {
+        dx = row.zr[column];
+        dy = row.zi[column];
+    }
+
+    int numIterations = startIteration;
+    int last = maxIterations < row.referenceLength ? maxIterations : row.referenceLength;
+
+    while (numIterations < last) {
+        double zx = referenceX[numIterations];
+        double zy = referenceY[numIterations];
+
+        //--δz(n+1) = 2 * Z(n) * δz(n) + δz(n)^2 + δc
+        double nx = 2 * ((zx * dx) - (zy * dy)) + ((dx * dx) - (dy * dy)) + dcx;
+        double ny = 2 * ((zx * dy) + (zy * dx)) + (2 * dx * dy) + dcy;
+        dx = nx;
+        dy = ny;
+        ++numIterations;
+
+        //--像素的 z = Z + δz
+        double rx = referenceX[numIterations];
+        double ry = referenceY[numIterations];
+        double ax = rx + dx;
+        double ay = ry + dy;
+        double magnitude = (ax * ax) + (ay * ay);
+
+        //--逃逸像素不再继续迭代, 保存完整的 z 而不是 δz, 供平滑着色使用
+        if (magnitude > Limit) {
+            row.status[column] = PixelEscaped;
+            dx = ax;
+            dy = ay;
+            break;
+        }
+
+        //--z 接近 0 而 Z 不接近时, δz 与 Z 相消, 剩下的有效位不足
+        if (magnitude < GlitchTolerance * ((rx * rx) + (ry * ry))) {
+            row.status[column] = PixelGlitched;
+            break;
+        }
+    }
+
+    //--参考点先逃逸, 轨道不够长, 本像素需要另一个参考点
+    if (row.status[column] == PixelUnresolved && numIterations < maxIterations)
+        row.status[column] = PixelGlitched;
+
+    row.zr[column] = dx;
+    row.zi[column] = dy;
+    row.iterations[column] = numIterations;
+}
+
+void perturbationRow(const PerturbationRow &row, const int *columns, int count,
+                     int startIteration, int maxIterations)
+{
+    for (int i = 0; i < count; ++i)
+        perturbationPixel(row, columns[i], startIteration, maxIterations);
+}
@@ -0,0 +1,90 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   深度缩放: 微扰(perturbation)逃逸时间内核
+*
+*           缩放小于约 1e-13 时, 相邻像素的 C 在 double 中已无法区分.
+*           只用多精度(MpFloat)计算一个参考点 C 的轨道 Z(n), 存成 double;
+*           其余像素 c = C + δc 只迭代偏差 δz = z - Z, 全部 double 运算:
+*               δz(n+1) = 2 * Z(n) * δz(n) + δz(n)^2 + δc
+*           δc, δz 都是像素间距的量级, double 的指数范围足够.
+*           |Z + δz| 远小于 |Z| 时(Pauldelbrot 判据)相对误差失控, 像素标记为 PixelGlitched,
+*           由调用方以其中一个像素为新参考点重算.
+**********************************************************/
+
+#ifndef PERTURBATION_H
+#define PERTURBATION_H
+
+#include "mpfloat.h"
+
+#include <vector>
+
+/*!
+ * \brief 参考轨道: Z(0) = C, Z(n+1) = Z(n)^2 + C, 多精度迭代, 按 double 保存
+ *        可以分轮延长(每轮最大迭代次数增大时只算新增部分); 参考点逃逸后不再延长
+ */
+class ReferenceOrbit
+{
+public:
+    ReferenceOrbit();
+
+    void reset(const MpFloat &centerX, const MpFloat &centerY);
+
+    /*!
+     * \brief 延长到 Z(maxIterations), 参考点先逃逸则停在逃逸处
+     */
+    void extend(int maxIterations);
+
+    ///--可用的最后一个下标, Z(0) ~ Z(length())
+    int length() const { return int(orbitX.size()) - 1; }
+
+    ///--参考点已逃逸, 轨道不会再延长
+    bool isEscaped() const { return escaped; }
+
+    const double *x() const { return orbitX.data(); }
+    const double *y() const { return orbitY.data(); }
+
+    const MpFloat &centerX() const { return cx; }
+    const MpFloat &centerY() const { return cy; }
+
+private:
+    MpFloat cx;
+    MpFloat cy;
+
+    ///--当前(最后一个) Z, 多精度
+    MpFloat zx;
+    MpFloat zy;
+    bool escaped;
+
+    std::vector<double> orbitX;
+    std::vector<double> orbitY;
+};
+
+/*!
+ * \brief 一行像素的微扰状态, 指针指向迭代状态缓冲区中该行第 0 列
+ *        第 i 列像素: δc = ((x0 + i) * scaleFactor, dcy), 相对参考点;
+ *        缓冲区的 zr / zi 保存 δz 而不是 z
+ */
+struct PerturbationRow
+{
+    const double *referenceX;   //--参考轨道 Z(n)
+    const double *referenceY;
+    int referenceLength;        //--ReferenceOrbit::length()
+    double scaleFactor;
+    double x0;
+    double dcy;
+    double *zr;                 //--δz 实部
+    double *zi;                 //--δz 虚部
+    int *iterations;
+    unsigned char *status;      //--PixelStatus
+};
+
+/*!
+ * \brief 微扰迭代 columns 中的像素, 约定同 EscapeTimeRowFunction:
+ *        像素都未逃逸, 已迭代 startIteration 次(为 0 时 δz 从 δc 开始), 迭代到 maxIterations;
+ *        结果为 PixelEscaped / PixelGlitched, 或保持 PixelUnresolved
+ */
+void perturbationRow(const PerturbationRow &row, const int *columns, int count,
+                     int startIteration, int maxIterations);
+
+#endif // PERTURBATION_H
@@ -0,0 +1,678 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   按精度分级的逃逸时间内核: float / double-double / 128 位定点数
+*
+*           算法与 mandelbrotkernel.cpp 的标量版本相同(含内部点捷径),
+*           数值类型作为模板参数, 每种类型各生成一份完全内联的内层循环.
+*           double-double 用 Dekker 分拆求精确积, 依赖 -ffp-contract=off(见 mandelbrot.pro).
+**********************************************************/
+
+#include "precisionkernel.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PRECISION_X86_SIMD
+#endif
+
+/// \brief 幅值 Limit = 2^2 = 4
+static const double Limit = 4;
+
+//--------------------------------------------------------------------
+// double-double: 值 = hi + lo, |lo| <= ulp(hi) / 2
+
+struct DoubleDouble
+{
+    double hi;
+    double lo;
+
+    DoubleDouble() : hi(0), lo(0) {}
+    explicit DoubleDouble(double value) : hi(value), lo(0) {}
+    DoubleDouble(double hi, double lo) : hi(hi), lo(lo) {}
+
+    bool operator==(const DoubleDouble &other) const { return hi == other.hi && lo == other.lo; }
+};
+
+///--s + e = a + b, 要求 |a| >= |b|
+static inline DoubleDouble quickTwoSum(double a, double b)
+{
+    double s = a + b;
+    return DoubleDouble(s, b - (s - a));
+}
+
+///--s + e = a + b
+static inline DoubleDouble twoSum(double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    return DoubleDouble(s, (a - (s - bb)) + (b - bb));
+}
+
+///--p + e = a * b, Dekker 把乘数分成两个 26 位的半字, 半字相乘没有舍入
+static inline DoubleDouble twoProduct(double a, double b)
+{
+    const double Splitter = 134217729.0;    //--2^27 + 1
+    double p = a * b;
+    double t = Splitter * a;
+    double ah = t - (t - a);
+    double al = a - ah;
+    t = Splitter * b;
+    double bh = t - (t - b);
+    double bl = b - bh;
+    return DoubleDouble(p, (((ah * bh) - p) + (ah * bl) + (al * bh)) + (al * bl));
+}
+
+static inline DoubleDouble operator+(const DoubleDouble &a, const DoubleDouble &b)
+{
+    DoubleDouble s = twoSum(a.hi, b.hi);
+    DoubleDouble t = twoSum(a.lo, b.lo);
+    s = quickTwoSum(s.hi, s.lo + t.hi);
+    return quickTwoSum(s.hi, s.lo + t.lo);
+}
+
+static inline DoubleDouble operator-(const DoubleDouble &a, const DoubleDouble &b)
+{
+    return a + DoubleDouble(-b.hi, -b.lo);
+}
+
+static inline DoubleDouble operator*(const DoubleDouble &a, const DoubleDouble &b)
+{
+    DoubleDouble p = twoProduct(a.hi, b.hi);
+    return quickTwoSum(p.hi, p.lo + ((a.hi * b.lo) + (a.lo * b.hi)));
+}
+
+//--------------------------------------------------------------------
+// 128 位定点数 Q5.123: 二进制补码, 值 = raw / 2^123, 范围 [-16, 16)
+// 迭代中 |a|, |b| < 2, a * a, 2 * a * b + ay 都不会溢出; 逃逸判断转成 double 计算
+
+#ifdef __SIZEOF_INT128__
+#define PRECISION_FIXED128
+
+typedef unsigned __int128 uint128;
+
+struct Fixed128
+{
+    enum { FractionBits = 123 };
+
+    uint128 raw;
+
+    Fixed128() : raw(0) {}
+
+    /*!
+     * \brief 由 double 转换, 低于 2^-123 的位截断
+     */
+    explicit Fixed128(double value)
+    {
+        double magnitude = fabs(value);
+        double high = floor(ldexp(magnitude, FractionBits - 64));
+        double rest = ldexp(magnitude, FractionBits - 64) - high;
+        raw = (uint128(uint64_t(high)) << 64) | uint64_t(ldexp(rest, 64));
+        if (value < 0)
+            raw = -raw;
+    }
+
+    bool isNegative() const { return int64_t(uint64_t(raw >> 64)) < 0; }
+
+    ///--只取高 64 位, 误差 2^-59, 用于逃逸判断和内部点判定
+    double toDouble() const { return ldexp(double(int64_t(uint64_t(raw >> 64))), 64 - FractionBits); }
+
+    bool operator==(const Fixed128 &other) const { return raw == other.raw; }
+};
+
+static inline Fixed128 operator+(const Fixed128 &a, const Fixed128 &b)
+{
+    Fixed128 result;
+    result.raw = a.raw + b.raw;
+    return result;
+}
+
+static inline Fixed128 operator-(const Fixed128 &a, const Fixed128 &b)
+{
+    Fixed128 result;
+    result.raw = a.raw - b.raw;
+    return result;
+}
+
+/*!
+ * \brief 绝对值相乘得 256 位积, 右移 123 位(截断), 再恢复符号
+ */
+static inline Fixed128 operator*(const Fixed128 &a, const Fixed128 &b)
+{
+    uint128 x = a.isNegative() ? -a.raw : a.raw;
+    uint128 y = b.isNegative() ? -b.raw : b.raw;
+
+    uint64_t x1 = uint64_t(x >> 64);
+    uint64_t x0 = uint64_t(x);
+    uint64_t y1 = uint64_t(y >> 64);
+    uint64_t y0 = uint64_t(y);
+
+    uint128 p00 = uint128(x0) * y0;
+    uint128 p01 = uint128(x0) * y1;
+    uint128 p10 = uint128(x1) * y0;
+    uint128 p11 = uint128(x1) * y1;
+
+    uint128 middle = (p00 >> 64) + uint64_t(p01) + uint64_t(p10);
+    uint128 high = p11 + (p01 >> 64) + (p10 >> 64) + (middle >> 64);
+    uint128 low = (middle << 64) | uint64_t(p00);
+
+    Fixed128 result;
+    result.raw = (high << (128 - Fixed128::FractionBits)) | (low >> Fixed128::FractionBits);
+    if (a.isNegative() != b.isNegative())
+        result.raw = -result.raw;
+    return result;
+}
+
+#endif // __SIZEOF_INT128__
+
+//--------------------------------------------------------------------
+// 各数值类型: 由多精度中心转换, 与 double 互转, 在迭代状态缓冲区中的存取
+
+static inline void fromMultiprecision(const MpFloat &value, float *result)
+{
+    *result = float(value.toDouble());
+}
+
+static inline void fromMultiprecision(const MpFloat &value, DoubleDouble *result)
+{
+    double hi = value.toDouble();
+    *result = DoubleDouble(hi, (value - MpFloat(hi)).toDouble());
+}
+
+static inline double toDouble(float value) { return value; }
+static inline double toDouble(const DoubleDouble &value) { return value.hi; }
+
+///--逃逸判断: float 按 float 计算, 与向量版本一致; 其余类型只需 double 精度
+static inline bool escapedNumber(float a, float b)
+{
+    return (a * a) + (b * b) > float(Limit);
+}
+
+template <typename Number>
+static inline bool escapedNumber(const Number &a1, const Number &b1)
+{
+    double a = toDouble(a1);
+    double b = toDouble(b1);
+    return (a * a) + (b * b) > Limit;
+}
+
+static inline void loadNumber(const PrecisionRow &row, int column, float *a, float *b)
+{
+    *a = float(row.zr[column]);
+    *b = float(row.zi[column]);
+}
+
+static inline void storeNumber(const PrecisionRow &row, int column, float a, float b)
+{
+    row.zr[column] = a;
+    row.zi[column] = b;
+}
+
+static inline void loadNumber(const PrecisionRow &row, int column, DoubleDouble *a, DoubleDouble *b)
+{
+    *a = DoubleDouble(row.zr[column], row.zrLo[column]);
+    *b = DoubleDouble(row.zi[column], row.ziLo[column]);
+}
+
+static inline void storeNumber(const PrecisionRow &row, int column,
+                               const DoubleDouble &a, const DoubleDouble &b)
+{
+    row.zr[column] = a.hi;
+    row.zrLo[column] = a.lo;
+    row.zi[column] = b.hi;
+    row.ziLo[column] = b.lo;
+}
+
+#ifdef PRECISION_FIXED128
+
+static inline void fromMultiprecision(const MpFloat &value, Fixed128 *result)
+{
+    //--三个 double 逐段取出 159 位有效位, 超过定点数的 123 位小数
+    double hi = value.toDouble();
+    MpFloat rest = value - MpFloat(hi);
+    double middle = rest.toDouble();
+    double lo = (rest - MpFloat(middle)).toDouble();
+    *result = Fixed128(hi) + Fixed128(middle) + Fixed128(lo);
+}
+
+static inline double toDouble(const Fixed128 &value) { return value.toDouble(); }
+
+///--定点数的高/低 64 位按位存入两个 double, 只在本内核内部读写
+static inline void loadWords(const double *high, const double *low, Fixed128 *value)
+{
+    uint64_t words[2];
+    memcpy(&words[0], high, sizeof(uint64_t));
+    memcpy(&words[1], low, sizeof(uint64_t));
+    value->raw = (uint128(words[0]) << 64) | words[1];
+}
+
+static inline void storeWords(double *high, double *low, const Fixed128 &value)
+{
+    uint64_t words[2] = { uint64_t(value.raw >> 64), uint64_t(value.raw) };
+    memcpy(high, &words[0], sizeof(uint64_t));
+    memcpy(low, &words[1], sizeof(uint64_t));
+}
+
+static inline void loadNumber(const PrecisionRow &row, int column, Fixed128 *a, Fixed128 *b)
+{
+    loadWords(row.zr + column, row.zrLo + column, a);
+    loadWords(row.zi + column, row.ziLo + column, b);
+}
+
+static inline void storeNumber(const PrecisionRow &row, int column, const Fixed128 &a, const Fixed128 &b)
+{
+    storeWords(row.zr + column, row.zrLo + column, a);
+    storeWords(row.zi + column, row.ziLo + column, b);
+}
+
+#endif // PRECISION_FIXED128
+
+///--像素 C 的实部; float 先按 double 算出再舍入, 与向量版本一致
+template <typename Number>
+static inline Number pixelX(const Number &centerX, double centerXDouble, double offset)
+{
+    (void)centerXDouble;
+    return centerX + Number(offset);
+}
+
+template <>
+inline float pixelX<float>(const float &, double centerXDouble, double offset)
+{
+    return float(centerXDouble + offset);
+}
+
+//--------------------------------------------------------------------
+// 模板内核
+
+/*!
+ * \brief 标量版本, 继续迭代一个像素, 同 mandelbrotkernel.cpp 的 escapeTimePixel()
+ */
+template <typename Number>
+static inline void escapeTimePixel(const PrecisionRow &row, const Number &centerX, double centerXDouble,
+                                   const Number &ay, int column, int startIteration, int maxIterations)
+{
+    Number ax = pixelX(centerX, centerXDouble, (row.x0 + column) * row.scaleFactor);
+
+    Number a1 = ax;
+    Number b1 = ay;
+    if (startIteration > 0)
+        loadNumber(row, column, &a1, &b1);
+
+    int numIterations = startIteration;
+
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+    Number savedA = a1;
+    Number savedB = b1;
+    int checkpoint = numIterations + 1;
+    int window = 1;
+
+    while (numIterations < maxIterations) {
+        ++numIterations;
+
+        //-- Z(n+1)=(Zn)^2+C
+        Number ab = a1 * b1;
+        a1 = (a1 * a1) - (b1 * b1) + ax;
+        b1 = ab + ab + ay;
+
+        if (escapedNumber(a1, b1)) {
+            row.status[column] = PixelEscaped;
+            break;
+        }
+
+        if (periodicity) {
+            if (a1 == savedA && b1 == savedB) {
+                row.status[column] = PixelPeriodic;
+                break;
+            }
+            if (numIterations == checkpoint) {
+                savedA = a1;
+                savedB = b1;
+                window <<= 1;
+                checkpoint += window;
+            }
+        }
+    }
+
+    //--逃逸像素不再继续迭代, z 按 double 保存(定点数不再按位存放), 供平滑着色使用
+    if (row.status[column] == PixelEscaped) {
+        row.zr[column] = toDouble(a1);
+        row.zi[column] = toDouble(b1);
+    } else {
+        storeNumber(row, column, a1, b1);
+    }
+    row.iterations[column] = numIterations;
+}
+
+/*!
+ * \brief 首轮主心形 / 周期 2 圆盘判定, 同 mandelbrotkernel.cpp 的 filterInterior();
+ *        判定用 double, 只会在离心形边界 1e-16 以内误判, 那里的点本来也迭代不到逃逸
+ */
+template <typename Number>
+static int filterInterior(const PrecisionRow &row, int *columns, int count, int startIteration,
+                          const Number &centerX, double centerXDouble, const Number &ay)
+{
+    if (startIteration > 0 || !(row.options & EscapeTimeCardioid))
+        return count;
+
+    double y = toDouble(ay);
+    int remaining = 0;
+    for (int i = 0; i < count; ++i) {
+        int column = columns[i];
+        double offset = (row.x0 + column) * row.scaleFactor;
+
+        if (insideCardioidOrBulb(centerXDouble + offset, y)) {
+            storeNumber(row, column, pixelX(centerX, centerXDouble, offset), ay);
+            row.iterations[column] = 0;
+            row.status[column] = PixelInsideBulb;
+        } else {
+            columns[i] = columns[remaining];
+            columns[remaining++] = column;
+        }
+    }
+    return remaining;
+}
+
+template <typename Number>
+static void escapeTimeRow(const PrecisionRow &row, int *columns, int count,
+                          int startIteration, int maxIterations)
+{
+    Number centerX;
+    Number ay;
+    fromMultiprecision(row.centerX, &centerX);
+    fromMultiprecision(row.ay, &ay);
+    double centerXDouble = row.centerX.toDouble();
+
+    count = filterInterior(row, columns, count, startIteration, centerX, centerXDouble, ay);
+    for (int i = 0; i < count; ++i)
+        escapeTimePixel(row, centerX, centerXDouble, ay, columns[i], startIteration, maxIterations);
+}
+
+#ifdef PRECISION_X86_SIMD
+
+//--------------------------------------------------------------------
+// float 向量版本: GCC 向量扩展, 由调用函数的 target 属性决定生成 SSE2 / AVX2 / AVX-512 指令
+
+typedef float Float4 __attribute__((vector_size(16)));
+typedef int Int4 __attribute__((vector_size(16)));
+typedef float Float8 __attribute__((vector_size(32)));
+typedef int Int8 __attribute__((vector_size(32)));
+typedef float Float16 __attribute__((vector_size(64)));
+typedef int Int16 __attribute__((vector_size(64)));
+
+/*!
+ * \brief Lanes 个像素同时迭代, 已逃逸/已检测到周期的通道用掩码冻结;
+ *        检查是否全部结束需要逐通道归约, 每 8 次迭代检查一次, 多出的迭代不改变冻结通道的结果
+ */
+template <typename Vector, typename Mask, int Lanes>
+static inline __attribute__((always_inline))
+void escapeTimeFloatLanes(const PrecisionRow &row, const int *columns, double centerX, float ay,
+                          int startIteration, int maxIterations)
+{
+    Vector ax;
+    Vector a;
+    Vector b;
+    for (int lane = 0; lane < Lanes; ++lane) {
+        ax[lane] = float(centerX + ((row.x0 + columns[lane]) * row.scaleFactor));
+        a[lane] = startIteration > 0 ? float(row.zr[columns[lane]]) : ax[lane];
+        b[lane] = startIteration > 0 ? float(row.zi[columns[lane]]) : ay;
+    }
+
+    const Vector vAy = ay - Vector();
+    const Vector vLimit = float(Limit) - Vector();
+    const bool periodicity = row.options & EscapeTimePeriodicity;
+
+    Mask active = Mask() == Mask();
+    Mask periodic = Mask();
+    Mask counts = maxIterations - Mask();
+
+    Vector savedA = a;
+    Vector savedB = b;
+    int checkpoint = startIteration + 1;
+    int window = 1;
+
+    for (int n = startIteration + 1; n <= maxIterations; ++n) {
+        Vector ab = a * b;
+        Vector a2 = (a * a) - (b * b) + ax;
+        Vector b2 = ab + ab + vAy;
+        Vector mag = (a2 * a2) + (b2 * b2);
+
+        Mask escaped = (mag > vLimit) & active;
+        counts = escaped ? n - Mask() : counts;
+
+        a = active ? a2 : a;
+        b = active ? b2 : b;
+        active &= ~escaped;
+
+        if (periodicity) {
+            //--两次比较的结果再相与, GCC 会逐通道展开; 按位异或后只比较一次, 位相同即数值相同
+            Mask cycle = ((Mask(a) ^ Mask(savedA)) | (Mask(b) ^ Mask(savedB))) == Mask();
+            cycle &= active;
+            counts = cycle ? n - Mask() : counts;
+            periodic |= cycle;
+            active &= ~cycle;
+
+            if (n == checkpoint) {
+                savedA = a;
+                savedB = b;
+                window <<= 1;
+                checkpoint += window;
+            }
+        }
+
+        if ((n & 7) == 0) {
+            int any = 0;
+            for (int lane = 0; lane < Lanes; ++lane)
+                any |= active[lane];
+            if (!any)
+                break;
+        }
+    }
+
+    for (int lane = 0; lane < Lanes; ++lane) {
+        int column = columns[lane];
+        row.zr[column] = a[lane];
+        row.zi[column] = b[lane];
+        row.iterations[column] = counts[lane];
+        if (periodic[lane])
+            row.status[column] = PixelPeriodic;
+        else if (!active[lane])
+            row.status[column] = PixelEscaped;
+    }
+}
+
+template <typename Vector, typename Mask, int Lanes>
+static inline __attribute__((always_inline))
+void escapeTimeFloatRow(const PrecisionRow &row, int *columns, int count,
+                        int startIteration, int maxIterations)
+{
+    float centerX;
+    float ay;
+    fromMultiprecision(row.centerX, &centerX);
+    fromMultiprecision(row.ay, &ay);
+    double centerXDouble = row.centerX.toDouble();
+
+    count = filterInterior(row, columns, count, startIteration, centerX, centerXDouble, ay);
+
+    int i = 0;
+    for (; i + Lanes <= count; i += Lanes)
+        escapeTimeFloatLanes<Vector, Mask, Lanes>(row, columns + i, centerXDouble, ay,
+                                                  startIteration, maxIterations);
+
+    //--不足一个向量的剩余像素: 用最后一列补满通道, 重复的通道结果相同, 重复写回无妨;
+    //--后续轮次每行只剩几个像素, 逐个标量迭代会比 double 向量内核还慢
+    if (i < count) {
+        int padded[Lanes];
+        for (int lane = 0; lane < Lanes; ++lane)
+            padded[lane] = columns[lane < count - i ? i + lane : count - 1];
+        escapeTimeFloatLanes<Vector, Mask, Lanes>(row, padded, centerXDouble, ay,
+                                                  startIteration, maxIterations);
+    }
+}
+
+__attribute__((target("sse2")))
+static void escapeTimeFloatSse2(const PrecisionRow &row, int *columns, int count,
+                                int startIteration, int maxIterations)
+{
+    escapeTimeFloatRow<Float4, Int4, 4>(row, columns, count, startIteration, maxIterations);
+}
+
+__attribute__((target("avx2")))
+static void escapeTimeFloatAvx2(const PrecisionRow &row, int *columns, int count,
+                                int startIteration, int maxIterations)
+{
+    escapeTimeFloatRow<Float8, Int8, 8>(row, columns, count, startIteration, maxIterations);
+}
+
+__attribute__((target("avx512f")))
+static void escapeTimeFloatAvx512(const PrecisionRow &row, int *columns, int count,
+                                  int startIteration, int maxIterations)
+{
+    escapeTimeFloatRow<Float16, Int16, 16>(row, columns, count, startIteration, maxIterations);
+}
+
+#endif // PRECISION_X86_SIMD
+
+PrecisionRowFunction precisionRowFunction(KernelPrecision precision, KernelIsa isa)
+{
+    switch (precision) {
+    case PrecisionFloat:
+#ifdef PRECISION_X86_SIMD
+        if (isa == KernelAvx512)
+            return escapeTimeFloatAvx512;
+        if (isa == KernelAvx2)
+            return escapeTimeFloatAvx2;
+        if (isa == KernelSse2)
+            return escapeTimeFloatSse2;
+#endif
+        (void)isa;
+        return escapeTimeRow<float>;
+    case PrecisionDoubleDouble:
+        return escapeTimeRow<DoubleDouble>;
+#ifdef PRECISION_FIXED128
+    case PrecisionFixed128:
+        return escapeTimeRow<Fixed128>;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+//--------------------------------------------------------------------
+// 精度选择
+
+/// \brief 像素间距至少是 C 的最低有效位的这么多倍, 迭代中舍入误差的放大才不致使相邻像素混在一起
+static const double MinUlpsPerPixel = 4096;
+
+/*!
+ * \brief 每个像素每次迭代的相对耗时(AVX-512 double 内核 = 1), 在 AVX-512 机器上实测(约 1ns);
+ *        float 向量内核通道数是 double 的两倍, 标量 float 与标量 double 相当
+ */
+static double iterationCost(KernelPrecision precision, KernelIsa isa)
+{
+    //--double 内核各指令集相对 AVX-512 的耗时
+    static const double DoubleCost[KernelIsaCount] = { 3, 2, 1.4, 1 };
+
+    switch (precision) {
+    case PrecisionFloat:
+        return isa == KernelScalar ? DoubleCost[isa] : DoubleCost[isa] * 0.6;
+    case PrecisionDouble:
+        return DoubleCost[isa];
+    case PrecisionDoubleDouble:
+        return 30;
+    case PrecisionFixed128:
+        return 35;
+    case PrecisionPerturbation:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+/*!
+ * \brief 微扰的参考轨道(MpFloat, 每次 3 个多精度乘法)每次迭代的相对耗时, 与像素数无关;
+ *        像素数超过约 25 个时微扰比 double-double / 定点数便宜
+ */
+static const double ReferenceIterationCost = 600;
+
+/*!
+ * \brief 精度是否足够区分相邻像素
+ */
+static bool precisionSuffices(KernelPrecision precision, double magnitude, double scaleFactor)
+{
+    switch (precision) {
+    case PrecisionFloat:
+        return scaleFactor >= ldexp(magnitude, -24) * MinUlpsPerPixel;
+    case PrecisionDouble:
+        return scaleFactor >= ldexp(magnitude, -53) * MinUlpsPerPixel;
+    case PrecisionDoubleDouble:
+        return scaleFactor >= ldexp(magnitude, -104) * MinUlpsPerPixel;
+    case PrecisionFixed128:
+#ifdef PRECISION_FIXED128
+        return magnitude < 2 && scaleFactor >= ldexp(1.0, -Fixed128::FractionBits) * MinUlpsPerPixel;
+#else
+        return false;
+#endif
+    case PrecisionPerturbation:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*!
+ * \brief double 和微扰内核不在本文件, 总是可用; 其余看 precisionRowFunction()
+ */
+static bool precisionAvailable(KernelPrecision precision, KernelIsa isa)
+{
+    return precision == PrecisionDouble || precision == PrecisionPerturbation
+            || precisionRowFunction(precision, isa);
+}
+
+KernelPrecision selectPrecision(double magnitude, double scaleFactor, long long pixels, KernelIsa isa)
+{
+    KernelPrecision best = PrecisionPerturbation;
+    double bestCost = pixels * iterationCost(PrecisionPerturbation, isa) + ReferenceIterationCost;
+
+    for (int precision = PrecisionFloat; precision < PrecisionPerturbation; ++precision) {
+        double cost = pixels * iterationCost(KernelPrecision(precision), isa);
+        if (cost < bestCost && precisionSuffices(KernelPrecision(precision), magnitude, scaleFactor)
+                && precisionAvailable(KernelPrecision(precision), isa)) {
+            best = KernelPrecision(precision);
+            bestCost = cost;
+        }
+    }
+
+    //--环境变量强制指定, 只接受精度足够的
+    const char *name = getenv("MANDELBROT_PRECISION");
+    if (name) {
+        for (int precision = 0; precision < PrecisionCount; ++precision) {
+            if (strcmp(name, precisionName(KernelPrecision(precision))) == 0
+                    && precisionSuffices(KernelPrecision(precision), magnitude, scaleFactor)
+                    && precisionAvailable(KernelPrecision(precision), isa))
+                return KernelPrecision(precision);
+        }
+    }
+
+    return best;
+}
+
+const char *precisionName(KernelPrecision precision)
+{
+    switch (precision) {
+    case PrecisionFloat:
+        return "float";
+    case PrecisionDouble:
+        return "double";
+    case PrecisionDoubleDouble:
+        return "double-double";
+    case PrecisionFixed128:
+        return "fixed128";
+    case PrecisionPerturbation:
+        return "perturbation";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,78 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   按精度分级的逃逸时间内核, 自动选择精度
+*
+*           缩放越深, 区分相邻像素需要的有效位越多:
+*               float(24 位) -> double(53 位, 见 mandelbrotkernel.h)
+*               -> double-double(约 106 位) -> 128 位定点数(Q5.123)
+*               -> 微扰(见 perturbation.h)
+*           同一算法按数值类型模板特化, 每种类型的运算全部内联在内层循环中;
+*           float 另有 SSE2(4路) / AVX2(8路) / AVX-512(16路) 向量版本.
+*           selectPrecision() 在精度足够的内核中按估算耗时选最便宜的一个.
+**********************************************************/
+
+#ifndef PRECISIONKERNEL_H
+#define PRECISIONKERNEL_H
+
+#include "mandelbrotkernel.h"
+#include "mpfloat.h"
+
+/*!
+ * \brief 内核精度, 由浅到深
+ */
+enum KernelPrecision {
+    PrecisionFloat,
+    PrecisionDouble,
+    PrecisionDoubleDouble,
+    PrecisionFixed128,
+    PrecisionPerturbation,
+    PrecisionCount
+};
+
+/*!
+ * \brief 一行像素的迭代状态, 第 i 列像素 C = (centerX + (x0 + i) * scaleFactor, ay), 多精度给出;
+ *        z 按内核的数值类型保存在 zr/zrLo, zi/ziLo 中:
+ *        float 只用 zr/zi; double-double 为高/低两部分; 128 位定点数按位存放高/低 64 位
+ */
+struct PrecisionRow
+{
+    MpFloat centerX;
+    MpFloat ay;
+    double scaleFactor;
+    double x0;
+    double *zr;
+    double *zi;
+    double *zrLo;
+    double *ziLo;
+    int *iterations;
+    unsigned char *status;      //--PixelStatus
+    int options;                //--EscapeTimeOption
+};
+
+/*!
+ * \brief 约定同 EscapeTimeRowFunction
+ */
+typedef void (*PrecisionRowFunction)(const PrecisionRow &row, int *columns, int count,
+                                     int startIteration, int maxIterations);
+
+/*!
+ * \brief 指定精度的内核, float 按指令集选向量版本;
+ *        double 用 escapeTimeRowFunction(), 微扰用 perturbationRow(), 这两种及编译器不支持时返回 nullptr
+ */
+PrecisionRowFunction precisionRowFunction(KernelPrecision precision, KernelIsa isa);
+
+/*!
+ * \brief 选择精度足够且估算耗时最少的内核
+ * \param magnitude 图像内 C 的最大分量绝对值(决定浮点数的分辨率)
+ * \param scaleFactor 像素间距
+ * \param pixels 图像像素数, 微扰的参考轨道是固定开销, 像素少时不划算
+ * \param isa 指令集, double / float 的向量宽度不同
+ *        环境变量 MANDELBROT_PRECISION=float|double|double-double|fixed128|perturbation 可强制指定,
+ *        精度不足时仍按自动选择
+ */
+KernelPrecision selectPrecision(double magnitude, double scaleFactor, long long pixels, KernelIsa isa);
+
+const char *precisionName(KernelPrecision precision);
+
+#endif // PRECISIONKERNEL_H
@@ -50,19 +50,68 @@
 
 #include "renderthread.h"
 
-#include <QtWidgets>
+#include <QElapsedTimer>
+#include <QImage>
 #include <cmath>
+#include <cstring>
+
+/*!
+ * \brief 分块缓存内存上限, 环境变量 MANDELBROT_TILE_CACHE_MB, 默认 256MB
+ */
+static qint64 tileCacheCapacity()
+{
+    int megabytes = qgetenv("MANDELBROT_TILE_CACHE_MB").toInt();
+    return qint64(megabytes > 0 ? megabytes : 256) * 1024 * 1024;
+}
+
+/*!
+ * \brief 分块缓存磁盘目录的大小上限, 环境变量 MANDELBROT_TILE_CACHE_DISK_MB, 默认 1024MB
+ */
+static qint64 tileCacheDiskCapacity()
+{
+    int megabytes = qgetenv("MANDELBROT_TILE_CACHE_DISK_MB").toInt();
+    return qint64(megabytes > 0 ? megabytes : 1024) * 1024 * 1024;
+}
 
 //! [0]
 RenderThread::RenderThread(QObject *parent)
-    : QThread(parent)
+    : QThread(parent),
+      //--环境变量 MANDELBROT_TILE_CACHE_DIR 指定目录时, 缓存分块跨进程保存在磁盘上
+      tileCache(tileCacheCapacity(), QString::fromLocal8Bit(qgetenv("MANDELBROT_TILE_CACHE_DIR")),
+                tileCacheDiskCapacity())
 {
-    restart = false;
-    abort = false;
+    restart.storeRelease(0);
+    abort.storeRelease(0);
+    request = 0;
+    options = InteriorChecks;
+    maxIterations = DefaultMaxIterations;
+    stats = Statistics();
+
+    //--运行时选择 SIMD 内核(AVX-512 / AVX2 / SSE2 / 标量)
+    kernelIsa = detectKernelIsa();
+    escapeTimeRow = escapeTimeRowFunction(kernelIsa);
+    colorRow = colorRowFunction(kernelIsa);
+
+    //--渲染线程自身也参与分块渲染, 线程池只需 CPU 核数 - 1 个线程
+    threadCount = qMax(1, QThread::idealThreadCount());
+    workerCount = threadCount;
+    pool.setMaxThreadCount(qMax(1, workerCount - 1));
+    speculationPool.setMaxThreadCount(workerCount);
+    budgetMs = 0;
+    budgetThreads = threadCount;
+    sliceDeadlineNs = 0;
+    busyNs.storeRelease(0);
+    speculating = false;
+    speculation = SpeculationCounters();
+    preempted.storeRelease(0);
 
     //--初始化颜色空间
-    for (int i = 0; i < ColormapSize; ++i)
-        colormap[i] = rgbFromWaveLength(380.0 + (i * 400.0 / ColormapSize));
+    palette = PaletteSpectrum;
+    colorOptions = 0;
+    colorOffset = 0;
+    recolor = false;
+    colormapPalette = palette;
+    fillPalette(colormapPalette, colormap);
 }
 //! [0]
 
@@ -70,7 +119,7 @@ RenderThread::RenderThread(QObject *parent)
 RenderThread::~RenderThread()
 {
     mutex.lock();
-    abort = true;
+    abort.storeRelease(1);
     condition.wakeOne();
     mutex.unlock();
 
@@ -81,12 +130,13 @@ RenderThread::~RenderThread()
 //! [2]
 /*!
  * \brief 外部调用,启动渲染，传入渲染参数(QMutexLocker保护)
- * \param centerX       中心x
- * \param centerY       中心y
+ * \param centerX       中心x, 多精度
+ * \param centerY       中心y, 多精度
  * \param scaleFactor   缩放比例
  * \param resultSize    结果大小
+ * \return 请求序号, 反映此请求的帧 FrameRing::Frame::request 不小于它
  */
-void RenderThread::render(double centerX, double centerY, double scaleFactor,
+qint64 RenderThread::render(const MpFloat &centerX, const MpFloat &centerY, double scaleFactor,
                           QSize resultSize)
 {
     QMutexLocker locker(&mutex);
@@ -95,17 +145,180 @@ void RenderThread::render(double centerX, double centerY, double scaleFactor,
     this->centerY = centerY;
     this->scaleFactor = scaleFactor;
     this->resultSize = resultSize;
+    ++request;
+    speculativeViews.clear();
 
     if (!isRunning()) {//--启动
         start(LowPriority);
-    } else {//--重启唤醒休眠的渲染线程
-        restart = true;
+    } else {//--重启唤醒休眠的渲染线程; 正在迭代的工作线程在下一个分段结束时看到
+        restart.storeRelease(1);
         condition.wakeOne();
     }
+    return request;
 }
 //! [2]
 
+/*!
+ * \brief 设置渲染选项
+ * \param options RenderOption 组合
+ */
+void RenderThread::setOptions(int options)
+{
+    QMutexLocker locker(&mutex);
+    this->options = options;
+}
+
+void RenderThread::setMaxIterations(int maxIterations)
+{
+    QMutexLocker locker(&mutex);
+    this->maxIterations = qMax(1, maxIterations);
+}
+
+void RenderThread::setThreadCount(int threadCount)
+{
+    QMutexLocker locker(&mutex);
+    this->threadCount = qMax(1, threadCount);
+}
+
+void RenderThread::setFrameBudget(int milliseconds, int threads)
+{
+    QMutexLocker locker(&mutex);
+    budgetMs = qMax(0, milliseconds);
+    budgetThreads = qMax(1, threads);
+}
+
+void RenderThread::setFractal(const Fractal &fractal)
+{
+    QMutexLocker locker(&mutex);
+    this->fractal = fractal;
+    this->fractal.exponent = qBound(int(MinMultibrotExponent), fractal.exponent, int(MaxMultibrotExponent));
+}
+
+void RenderThread::setPalette(Palette palette)
+{
+    QMutexLocker locker(&mutex);
+    this->palette = palette;
+    recolor = true;
+    preemptSpeculation();
+    condition.wakeOne();
+}
+
+void RenderThread::setColorOptions(int colorOptions)
+{
+    QMutexLocker locker(&mutex);
+    this->colorOptions = colorOptions;
+    recolor = true;
+    preemptSpeculation();
+    condition.wakeOne();
+}
+
+void RenderThread::setColorOffset(int colorOffset)
+{
+    QMutexLocker locker(&mutex);
+    this->colorOffset = colorOffset & (PaletteSize - 1);
+    recolor = true;
+    preemptSpeculation();
+    condition.wakeOne();
+}
+
+void RenderThread::setSpeculativeViews(const QVector<SpeculativeView> &views)
+{
+    QMutexLocker locker(&mutex);
+    speculativeViews = views;
+    preemptSpeculation();
+    condition.wakeOne();
+}
+
+RenderThread::SpeculationCounters RenderThread::speculationCounters()
+{
+    QMutexLocker locker(&mutex);
+    return speculation;
+}
+
+/*!
+ * \brief 正在推测时打断它(在 mutex 内调用); 真实渲染不受影响
+ */
+void RenderThread::preemptSpeculation()
+{
+    if (speculating)
+        preempted.storeRelease(1);
+}
+
+/*!
+ * \brief 最近一轮完成时的统计
+ */
+RenderThread::Statistics RenderThread::statistics()
+{
+    QMutexLocker locker(&mutex);
+    return stats;
+}
+
+TileCache::Counters RenderThread::tileCacheCounters()
+{
+    return tileCache.counters();
+}
+
+QVector<int> RenderThread::iterationMap()
+{
+    QMutexLocker locker(&mutex);
+    return finishedMap;
+}
+
 //! [3]
+/*!
+ * \brief 线程池中的工作线程, 与渲染线程一起领取分块
+ */
+class TileRunnable : public QRunnable
+{
+public:
+    TileRunnable(RenderThread *thread, RenderThread::TilePass *tilePass)
+        : thread(thread), tilePass(tilePass) {}
+
+    void run() override { thread->renderTiles(tilePass); }
+
+private:
+    RenderThread *thread;
+    RenderThread::TilePass *tilePass;
+};
+
+/*!
+ * \brief 线程池中的工作线程, 与渲染线程一起领取上色的行块
+ */
+class ColorRunnable : public QRunnable
+{
+public:
+    ColorRunnable(RenderThread *thread, RenderThread::ColorPass *colorPass)
+        : thread(thread), colorPass(colorPass) {}
+
+    void run() override { thread->colorRows(colorPass); }
+
+private:
+    RenderThread *thread;
+    RenderThread::ColorPass *colorPass;
+};
+
+/*!
+ * \brief 推测线程池中的工作线程: 以最低优先级领取分块
+ *        Linux 上 IdlePriority 是 SCHED_IDLE, 非特权线程降下去就回不到原来的策略,
+ *        所以只在推测专用的线程池中设置, 不恢复
+ */
+class SpeculationRunnable : public QRunnable
+{
+public:
+    SpeculationRunnable(RenderThread *thread, RenderThread::TilePass *tilePass)
+        : thread(thread), tilePass(tilePass) {}
+
+    void run() override
+    {
+        QThread::currentThread()->setPriority(QThread::IdlePriority);
+        thread->renderTiles(tilePass);
+    }
+
+private:
+    RenderThread *thread;
+    RenderThread::TilePass *tilePass;
+};
+
 void RenderThread::run()
 {
     forever {
@@ -115,131 +328,383 @@ void RenderThread::run()
         mutex.lock();
         QSize resultSize = this->resultSize;
         double scaleFactor = this->scaleFactor;
-        double centerX = this->centerX;
-        double centerY = this->centerY;
+        MpFloat deepCenterX = this->centerX;
+        MpFloat deepCenterY = this->centerY;
+        int options = this->options;
+        int maxIterations = this->maxIterations;
+        Fractal fractal = this->fractal;
+        qint64 request = this->request;
+        qint64 budgetNs = qint64(budgetMs) * 1000000;
+        int threads = budgetMs > 0 ? qMin(threadCount, budgetThreads) : threadCount;
+        if (workerCount != threads) {
+            workerCount = threads;
+            pool.setMaxThreadCount(qMax(1, workerCount - 1));
+            speculationPool.setMaxThreadCount(workerCount);
+        }
         mutex.unlock();
 //! [3]
 
+        double centerX = deepCenterX.toDouble();
+        double centerY = deepCenterY.toDouble();
+
 //! [4]
         int halfWidth = resultSize.width() / 2;
 //! [4] //! [5]
         int halfHeight = resultSize.height() / 2;
 
-        //--QImage::Format_RGB32 存储使用32位RGB格式的图像(0xffrrggbb)透明度a最大
-        QImage image(resultSize, QImage::Format_RGB32);
+        //--按图像内 C 的最大分量和像素间距选择精度足够、估算耗时最少的内核;
+        //--DeepZoom 强制微扰: 中心多精度参考轨道 + 每个像素 double 微扰
+        double magnitude = qMax(qAbs(centerX), qAbs(centerY)) + qMax(halfWidth, halfHeight) * scaleFactor;
+        KernelPrecision precision = selectPrecision(magnitude, scaleFactor,
+                                                    qint64(2 * halfWidth) * (2 * halfHeight), kernelIsa);
+        if (options & DeepZoom)
+            precision = PrecisionPerturbation;
 
-        ///-此数越大 图像精细度越高
-        const int NumPasses = 8;
-        int pass = 0;
+        //--其他分形只有 double 内核(fractalkernel.h); 分块缓存的键不含分形, 不缓存;
+        //--Mariani-Silver 只对连通的集合成立, 共轭对称只对镜像对称的分形成立
+        if (fractal.family != FractalMandelbrot) {
+            precision = PrecisionDouble;
+            options &= ~(DeepZoom | TileCaching);
+            if (!fractalConnected(fractal))
+                options &= ~MarianiSilver;
+            if (!fractalConjugateSymmetric(fractal))
+                options &= ~ConjugateSymmetry;
+        }
+        EscapeTimeRowFunction fractalRow = fractalRowFunction(fractal, kernelIsa);
 
-        while (pass < NumPasses) {
+        //--分块缓存的世界像素网格是 double 坐标, 缓存的是 double 内核的结果:
+        //--浅缩放时统一用 double, 更深时不使用分块缓存
+        if ((options & TileCaching) && precision <= PrecisionDouble)
+            precision = PrecisionDouble;
+        else
+            options &= ~TileCaching;
 
-            /// \brief 最大迭代
-            const int MaxIterations = (1 << (2 * pass + 6)) + 32;
+        //--参考轨道只取决于中心, 中心不变(如缩放序列)时已算出的部分继续使用
+        if (precision == PrecisionPerturbation) {
+            options |= DeepZoom;
+            if (reference.length() < 0 || reference.centerX() != deepCenterX
+                    || reference.centerY() != deepCenterY)
+                reference.reset(deepCenterX, deepCenterY);
+        }
 
-            /// \brief 幅值 Limit = 2^2 = 4
-            const int Limit = 4;
+        //--像素 (x, y) 处 C = (gridX + (x0 + x) * gridScale, gridY + (y0 + y) * gridScale)
+        double gridScale = scaleFactor;
+        double gridX = centerX;
+        double gridY = centerY;
+        double x0 = -halfWidth;
+        double y0 = -halfHeight;
+        qint64 scaleKey = 0;
 
-            bool allBlack = true;
+        if (options & TileCaching) {
+            //--缩放量化, 中心对齐到整数世界像素, C 只取决于世界像素坐标 (x0 + x, y0 + y),
+            //--任何视图算到同一世界分块时结果都逐位相同
+            scaleKey = TileCache::scaleKey(scaleFactor);
+            gridScale = TileCache::scaleForKey(scaleKey);
+            gridX = 0;
+            gridY = 0;
+            x0 = double(qRound64(centerX / gridScale) - halfWidth);
+            y0 = double(qRound64(centerY / gridScale) - halfHeight);
+        }
 
+        //--共轭对称: C 与其共轭的迭代逐位互为共轭(舍入对取反对称), 视图跨过实轴时行对齐到
+        //--以实轴为第 0 行的整数行(最多移动半个像素, 同分块缓存的对齐), 虚部逐行精确互为相反数,
+        //--实轴一侧较少的行由另一侧镜像. 定点数截断不对称, 微扰的参考点不在实轴上, 都不镜像
+        int rowTop = 0;
+        int rowBottom = 2 * halfHeight;
+        int axisRow = 0;
+        bool mirror = (options & ConjugateSymmetry) && precision <= PrecisionDoubleDouble
+                && qAbs(centerY) < halfHeight * gridScale;
+        if (mirror) {
+            //--实轴离上下边缘不到半个像素时取整后落在视图外(axisRow == 2 * halfHeight), 不镜像
+            axisRow = halfHeight - int(qRound64(centerY / gridScale));
+            mirror = axisRow >= 0 && axisRow < 2 * halfHeight;
+            if (!mirror)
+                axisRow = 0;
+        }
+        if (mirror) {
+            gridY = 0;
+            y0 = double(-axisRow);
 
-             //--逐行扫描,生成图像
-            for (int y = -halfHeight; y < halfHeight; ++y) {
+            //--实轴上方 axisRow 行, 下方 2 * halfHeight - axisRow - 1 行, 计算较多的一侧和实轴所在行
+            int above = axisRow;
+            int below = 2 * halfHeight - axisRow - 1;
+            if (above <= below)
+                rowTop = above;
+            else
+                rowBottom = qMin(axisRow + 1, 2 * halfHeight);
+        }
+        MpFloat preciseCenterY = mirror ? MpFloat(gridY) : deepCenterY;
 
-                //--重启
-                if (restart)
-                    break;
+        //--与上一次请求相比只是平移整数个像素时, 移动迭代状态, 只计算新露出的行列;
+        //--否则上一次请求的迭代状态全部作废
+        MpFloat originX(gridX + x0 * gridScale);
+        MpFloat originY(gridY + y0 * gridScale);
+        if (precision > PrecisionDouble) {
+            originX = deepCenterX + MpFloat(x0 * gridScale);
+            originY = preciseCenterY + MpFloat(y0 * gridScale);
+        }
+        bool reused = state.translate(originX, originY, gridScale, 2 * halfWidth, 2 * halfHeight,
+                                      options, precision, fractal);
+        if (!reused)
+            state.reset(2 * halfWidth, 2 * halfHeight);
+        state.originX = originX;
+        state.originY = originY;
+        state.scaleFactor = gridScale;
+        state.options = options;
+        state.precision = precision;
+        state.fractal = fractal;
 
-                //--终止
-                if (abort)
-                    return;
+        ///-每轮最大迭代次数翻 4 倍, 达到 maxIterations 为最后一轮, 此数越大 图像精细度越高;
+        ///-自适应时起点随缩放加深, 按上一轮的逃逸统计加大上限或提前结束
+        IterationSchedule schedule;
+        schedule.start(scaleFactor, 2 * halfWidth, maxIterations, options & AdaptiveIterations);
+        int pass = 0;
+        bool lastPass = false;
+
+        //--预览金字塔: 迭代状态从头开始时, 先只算间隔 8/4/2 的采样点(上限同第一轮)并按块填充,
+        //--每层跳过上一层已算的点, 第一轮全分辨率也只算剩下的像素; 平移复用时大部分像素已有结果, 不预览;
+        //--帧预算模式每片都发布已算出的部分, 本身就是渐进显示, 不预览
+        int sampleStep = (options & Preview) && !reused && budgetNs == 0 ? int(PreviewStep) : 1;
+        bool published = false;
 
-                //--读取当前行第一个像素
-                uint *scanLine =
-                        reinterpret_cast<uint *>(image.scanLine(y + halfHeight));
+        QElapsedTimer timer;
+        timer.start();
+        busyNs.storeRelease(0);
 
-                ///--虚部
-                double ay = centerY + (y * scaleFactor);
+        //--发布间隔统计: 次数, 和, 平方和(微秒), 上一次发布的时刻
+        qint64 frameCount = 0;
+        double intervalSum = 0;
+        double intervalSquares = 0;
+        qint64 lastPublishNs = 0;
 
-                //--每行逐个扫描像素
-                //--单个像素满足复平面函数关系Mandelbrot 集
-                for (int x = -halfWidth; x < halfWidth; ++x) {
+        //--本轮起还没计入推测统计的分块缓存命中/未命中
+        qint64 viewHits = 0;
+        qint64 viewMisses = 0;
 
-                    ///--实部
-                    double ax = centerX + (x * scaleFactor);
+        Statistics stats = Statistics();
+        stats.pixels = qint64(2 * halfWidth) * (2 * halfHeight);
+        stats.isa = kernelIsa;
+        stats.precision = precision;
 
-                    double a1 = ax;
-                    double b1 = ay;
+        while (!lastPass) {
 
-                    /// \brief 当前迭代次数
-                    int numIterations = 0;
+            TilePass tilePass;
 
+            //--帧预算: 本片从这里计时; 迭代的截止时间留出上一次上色的时间, 至少为预算的一半
+            sliceTimer.start();
+            sliceDeadlineNs = budgetNs > 0 ? qMax(budgetNs - stats.colorNs, budgetNs / 2) : 0;
 
-                    //--单个像素点处,迭代计算
-                    //--Mandelbrot 集:
-                    // Z(n+1)=(Zn)^2+C
-                    // 复数Z = a + bi
-                    // 连续计算MaxIterations次
-                    //--求得满足Mandelbrot集合的 第MaxIterations 个点(直到z的幅值大于2)
-                    do {
+            //--写入帧环的 back 帧(QImage::Format_RGB32, 0xffrrggbb): 渲染线程独占, 不与GUI线程共享,
+            //--bits() 不会分离出副本; 工作线程只写各自分块, 不调用 scanLine()
+            QElapsedTimer handoffTimer;
+            handoffTimer.start();
+            FrameRing::Frame *frame = frames.beginWrite(resultSize);
+            stats.handoffNs += handoffTimer.nsecsElapsed();
 
-                        //--增加迭代次数
-                        ++numIterations;
+            tilePass.bits = frame->image.bits();
+            tilePass.bytesPerLine = frame->image.bytesPerLine();
+            tilePass.width = 2 * halfWidth;
+            tilePass.height = 2 * halfHeight;
+            tilePass.centerX = gridX;
+            tilePass.centerY = gridY;
+            tilePass.scaleFactor = gridScale;
+            tilePass.x0 = x0;
+            tilePass.y0 = y0;
 
-                        //-- Z(n+1)=(Zn)^2+C
-                        //-- 复数Z = a + bi
+            /// \brief 最大迭代
+            tilePass.maxIterations = schedule.limit();
+            bool preview = sampleStep > 1;
+            tilePass.sampleStep = sampleStep;
+            tilePass.colorOffset = preview ? colorSettings().offset : 0;
 
-                        //---迭代一次-----
-                        //--实部
-                        double a2 = (a1 * a1) - (b1 * b1) + ax;
-                        //--虚部
-                        double b2 = (2 * a1 * b1) + ay;
+            //--分块缓存时分块网格与世界分块对齐, 图像边缘的分块不完整
+            tilePass.tileCaching = options & TileCaching;
+            tilePass.tileIndexX = 0;
+            tilePass.tileIndexY = 0;
+            tilePass.tileOffsetX = 0;
+            tilePass.tileOffsetY = 0;
+            tilePass.scaleKey = scaleKey;
+            if (tilePass.tileCaching) {
+                tilePass.tileIndexX = qint64(std::floor(x0 / TileSize));
+                tilePass.tileIndexY = qint64(std::floor(y0 / TileSize));
+                tilePass.tileOffsetX = int(qint64(x0) - tilePass.tileIndexX * TileSize);
+                tilePass.tileOffsetY = int(qint64(y0) - tilePass.tileIndexY * TileSize);
+            }
 
-                        //--直到z的幅值大于2, Limit = 2^2,退出
-                        if ((a2 * a2) + (b2 * b2) > Limit)
-                            break;
+            //--预览层按块上色, 镜像一侧的分块也要上色, 不镜像
+            tilePass.rowTop = preview ? 0 : rowTop;
+            tilePass.rowBottom = preview ? tilePass.height : rowBottom;
+            tilePass.axisRow = axisRow;
 
-                        //---继续迭代一次，记录上一次结果，用于下一次迭代-----
-                        ++numIterations;
-                        a1 = (a2 * a2) - (b2 * b2) + ax;
-                        b1 = (2 * a2 * b2) + ay;
+            tilePass.tileColumns = (tilePass.tileOffsetX + tilePass.width + TileSize - 1) / TileSize;
+            tilePass.tileCount = tilePass.tileColumns
+                    * ((tilePass.tileOffsetY + tilePass.height + TileSize - 1) / TileSize);
+            tilePass.nextTile.storeRelease(0);
+            tilePass.allBlack.storeRelease(1);
+            tilePass.kernelOptions = (options & InteriorChecks)
+                    ? EscapeTimeCardioid | EscapeTimePeriodicity : 0;
+            tilePass.marianiSilver = options & MarianiSilver;
+            tilePass.escapeTimeRow = fractalRow;
+            tilePass.juliaX = fractal.juliaX;
+            tilePass.juliaY = fractal.juliaY;
 
-                        //--直到z的幅值大于2, Limit = 2^2,退出
-                        if ((a1 * a1) + (b1 * b1) > Limit)
-                            break;
+            //--参考轨道延长到本轮最大迭代次数
+            tilePass.reference = nullptr;
+            if (options & DeepZoom) {
+                if (!extendOrbit(&reference, tilePass.maxIterations)) {
+                    if (abort.loadAcquire())
+                        return;
+                    if (restart.loadAcquire())
+                        break;
+                    continue;//--本片到时, 已延长的参考轨道保留, 下一片接着延长
+                }
+                tilePass.reference = &reference;
+            }
 
-                    } while (numIterations < MaxIterations);//--循环迭代直到次数大于限制或者z的幅值大于2
+            //--double 和微扰之外的精度, 中心按多精度传给内核
+            tilePass.precisionRow = precisionRowFunction(precision, kernelIsa);
+            if (tilePass.precisionRow) {
+                tilePass.preciseCenterX = deepCenterX;
+                tilePass.preciseCenterY = preciseCenterY;
+            }
 
+            //--分块并行渲染: 线程池工作线程和本线程一起动态领取分块
+            for (int i = 1; i < workerCount; ++i)
+                pool.start(new TileRunnable(this, &tilePass));
+            renderTiles(&tilePass);
+            pool.waitForDone();
+
+            //--终止
+            if (abort.loadAcquire())
+                return;
+
+            //--重启
+            if (restart.loadAcquire())
+                break;
+
+            //--深度缩放: 失真像素换参考点重算; 预览层的失真采样点暂按黑色, 留给第一轮
+            int references = 0;
+            if (tilePass.reference && !preview) {
+                references = resolveGlitches(&tilePass);
+                if (abort.loadAcquire())
+                    return;
+                if (restart.loadAcquire())
+                    break;
+            }
 
-                    //--退出循环时,幅值大于2,颜色取值
-                    //--轮廓外部彩色
-                    if (numIterations < MaxIterations) {
+            //--共轭对称: 没有计算的行从实轴另一侧复制, z 的虚部取反
+            int mirroredPixels = 0;
+            if (!preview && (rowTop > 0 || rowBottom < tilePass.height))
+                mirroredPixels = mirrorRows(&tilePass);
 
-                        //--设置此行当前位(x位置) 像素颜色,取颜色空间的值
-                        *scanLine++ = colormap[numIterations % ColormapSize];
-                        allBlack = false;
-                    }
+            //--帧预算: 本片到时, 本轮可能没算完; 照常上色发布(未确定的像素为黑色), 下一片继续本轮
+            bool expired = sliceExpired();
+            sliceDeadlineNs = 0;
 
-                    //--退出循环时,迭代到最大次数,颜色取值
-                    //--轮廓内部黑色
-                    else {
-                        //--设置此行当前位(x位置) 像素颜色
-                        *scanLine++ = qRgb(0, 0, 0);
-                    }
+            //--整幅上色, 与迭代分开: 换调色板时只重做这一步; 预览层已在分块中按块上色
+            bool allBlack = tilePass.allBlack.loadAcquire();
+            if (!preview) {
+                QElapsedTimer colorTimer;
+                colorTimer.start();
+                allBlack = !colorImage(frame->image.bits(), frame->image.bytesPerLine());
+                stats.colorNs = colorTimer.nsecsElapsed();
+            }
 
-                }//--for每行逐个扫描
-            }//--for逐行扫描
+            //--一轮算完后才知道是否为最后一轮: 自适应时看本轮的逃逸统计
+            if (!preview && !expired) {
+                schedule.finishPass(schedule.isAdaptive()
+                                    ? summarizePass(schedule, QRect(0, 0, state.width, state.height))
+                                    : IterationSchedule::PassSummary());
+                lastPass = schedule.isFinished();
+                stats.passes = pass + 1;
+                stats.maxIterations = tilePass.maxIterations;
+                stats.savedIterations = schedule.savedIterations();
+            }
+            stats.iteratedPixels += tilePass.iteratedPixels.loadAcquire();
+            stats.iterations += tilePass.iterations.loadAcquire();
+            stats.bulbPixels += tilePass.bulbPixels.loadAcquire();
+            stats.periodicPixels += tilePass.periodicPixels.loadAcquire();
+            stats.filledPixels += tilePass.filledPixels.loadAcquire();
+            stats.mirroredPixels += mirroredPixels;
+            stats.cacheHits += tilePass.cacheHits.loadAcquire();
+            stats.cacheMisses += tilePass.cacheMisses.loadAcquire();
+            if (!preview) {
+                viewHits += tilePass.cacheHits.loadAcquire();
+                viewMisses += tilePass.cacheMisses.loadAcquire();
+            }
+            stats.references = references;
+            stats.glitchedPixels += tilePass.glitchedPixels.loadAcquire();
+            stats.elapsedMs = timer.elapsed();
+            stats.cpuPercent = int(busyNs.loadAcquire() * 100
+                                   / qMax(qint64(1), timer.nsecsElapsed() * qMax(1, QThread::idealThreadCount())));
 
             //--第一轮,并且当前图像全黑,从第５(pass=4)轮开始
             //--因为这种情况下pass = 0 1 2 3 是全黑
-            //--在轮廓内部
-            if (allBlack && pass == 0) {
-                pass = 4;
-            } else {//--包含轮廓,触发GUI线程绘制图像
-                if (!restart)
-                    emit renderedImage(image, scaleFactor);
+            //--在轮廓内部; 预览层全黑时同样不发布, 直接算第一轮
+            bool skipped = allBlack && pass == 0 && !lastPass && !expired;
+
+            //--包含轮廓, 发布到帧环(只交换下标), back 换成另一个缓冲区
+            if (!skipped) {
+                handoffTimer.start();
+                frame->scaleFactor = scaleFactor;
+                frame->pass = pass;
+                frame->request = request;
+                frames.publish();
+                stats.handoffNs += handoffTimer.nsecsElapsed();
+
+                if (preview)
+                    ++stats.previewLevels;
+                if (expired)
+                    ++stats.budgetFrames;
+                if (!published)
+                    stats.firstFrameMs = timer.elapsed();
+                published = true;
+
+                //--发布间隔的平均值和标准差(抖动)
+                qint64 now = timer.nsecsElapsed();
+                double interval = (now - lastPublishNs) * 1e-3;
+                lastPublishNs = now;
+                ++frameCount;
+                intervalSum += interval;
+                intervalSquares += interval * interval;
+                double mean = intervalSum / frameCount;
+                stats.frameIntervalUs = qint64(mean);
+                stats.frameJitterUs = qint64(std::sqrt(qMax(0.0, intervalSquares / frameCount - mean * mean)));
+                stats.maxFrameIntervalUs = qMax(stats.maxFrameIntervalUs, qint64(interval));
+            }
+
+            mutex.lock();
+            this->stats = stats;
+            speculation.viewHits += viewHits;
+            speculation.viewMisses += viewMisses;
+            mutex.unlock();
+            viewHits = 0;
+            viewMisses = 0;
+
+            if (preview) {
+                if (!skipped)
+                    emit frameReady();
+                sampleStep = skipped ? 1 : sampleStep / 2;
+            } else if (expired) {
+                emit frameReady();//--同一轮, 下一片继续
+            } else if (skipped) {
+                schedule.skipBlack();
+                pass = schedule.pass();
+            } else {//--触发GUI线程绘制图像
+                emit frameReady();
 //! [5] //! [6]
-                ++pass;
+                pass = schedule.pass();
+            }
+
+            //--迭代次数快照: 之后的空闲推测会换出并重置 state, iterationMap() 只读快照
+            if (lastPass) {
+                QVector<int> map(state.width * state.height);
+                for (int i = 0; i < map.size(); ++i)
+                    map[i] = state.status[i] == PixelEscaped ? state.iterations[i] : -1;
+                mutex.lock();
+                finishedMap.swap(map);
+                mutex.unlock();
+                emit renderFinished();
             }
 
 //! [6] //! [7]
@@ -247,58 +712,914 @@ void RenderThread::run()
 //! [7]
 
 //! [8]
-        //--渲染完毕休眠等待condition.wakeOne()唤醒
-        mutex.lock();
+        //--渲染完毕休眠等待condition.wakeOne()唤醒;
+        //--只改了上色设置时, 用最后一轮的迭代状态重新上色并发布, 不重新迭代;
+        //--有待推测的视图时不休眠, 逐个推测, 新的请求或设置到来时立即停下
+        forever {
+            mutex.lock();
+            preempted.storeRelease(0);
+            bool idle = !restart.loadAcquire() && !recolor && !abort.loadAcquire();
+            bool speculative = idle && (this->options & Speculation) && (this->options & TileCaching)
+                    && this->fractal.family == FractalMandelbrot && !speculativeViews.isEmpty();
+            SpeculativeView view;
+            if (speculative) {
+                view = speculativeViews.takeFirst();
+                ++speculation.views;
+            }
+            speculating = speculative;
+            int speculativeOptions = this->options;
+            int speculativeMaxIterations = this->maxIterations;
 //! [8] //! [9]
-        if (!restart)
-            condition.wait(&mutex);
-        restart = false;
-        mutex.unlock();
+            if (idle && !speculative)
+                condition.wait(&mutex);
+            bool recolorOnly = recolor && !restart.loadAcquire() && !abort.loadAcquire();
+            if (!recolorOnly && !speculative)
+                restart.storeRelease(0);
+            mutex.unlock();
+
+            if (speculative) {
+                bool finished = speculate(view, speculativeOptions, speculativeMaxIterations);
+                mutex.lock();
+                speculating = false;
+                if (!finished)
+                    ++speculation.preempted;
+                mutex.unlock();
+                if (abort.loadAcquire())
+                    return;
+                continue;
+            }
+
+            if (!recolorOnly)
+                break;
+
+            QElapsedTimer colorTimer;
+            colorTimer.start();
+            FrameRing::Frame *frame = frames.beginWrite(resultSize);
+            colorImage(frame->image.bits(), frame->image.bytesPerLine());
+            frame->scaleFactor = scaleFactor;
+            frame->pass = stats.passes - 1;
+            frame->request = request;
+            frames.publish();
+            stats.colorNs = colorTimer.nsecsElapsed();
+
+            mutex.lock();
+            this->stats.colorNs = stats.colorNs;
+            mutex.unlock();
+
+            emit frameReady();
+        }
     }
 }
 //! [9]
 
-//! [10]
 /*!
- * \brief 一个辅助函数，它将波长转换为与32位QImages兼容的RGB值。
- *        从构造函数中调用它，以使用令人满意的颜色初始化colormap数组。
- * \param wave
- * \return
+ * \brief 工作线程循环: 领取分块直到本轮分块领完, 或者重启/终止
+ * \param tilePass
+ */
+void RenderThread::renderTiles(TilePass *tilePass)
+{
+    QElapsedTimer busyTimer;
+    busyTimer.start();
+
+    forever {
+        if (interrupted())
+            break;
+
+        int tile = tilePass->nextTile.fetchAndAddRelaxed(1);
+        if (tile >= tilePass->tileCount)
+            break;
+
+        renderTile(tilePass, tile);
+    }
+
+    busyNs.fetchAndAddRelaxed(busyTimer.nsecsElapsed());
+}
+
+/*!
+ * \brief 渲染一个分块: 先迭代(逐行扫描或 Mariani-Silver), 再按迭代状态上色
+ * \param tilePass
+ * \param tile 分块序号, 按行排列
+ */
+void RenderThread::renderTile(TilePass *tilePass, int tile)
+{
+    int tileLeft = (tile % tilePass->tileColumns) * TileSize - tilePass->tileOffsetX;
+    int tileTop = (tile / tilePass->tileColumns) * TileSize - tilePass->tileOffsetY;
+    int left = qMax(tileLeft, 0);
+    int top = qMax(tileTop, tilePass->rowTop);
+    int right = qMin(tileLeft + TileSize, tilePass->width);
+    int bottom = qMin(qMin(tileTop + TileSize, tilePass->rowBottom), tilePass->height);
+
+    //--整块都在镜像的行内
+    if (top >= bottom)
+        return;
+
+    //--统计, 分块结束时一次累加到本轮
+    TileCounters counters = TileCounters();
+
+    //--预览层的采样点以分块左上角(裁剪后)为原点, 每个分块自己上色, 不读其他分块
+    int step = tilePass->sampleStep;
+
+    TileKey key;
+    bool cacheable = false;
+    if (tilePass->tileCaching && step == 1 && tileNeedsWork(tilePass, left, top, right, bottom)) {
+        key.scale = tilePass->scaleKey;
+        key.x = tilePass->tileIndexX + tile % tilePass->tileColumns;
+        key.y = tilePass->tileIndexY + tile / tilePass->tileColumns;
+        key.maxIterations = tilePass->maxIterations;
+        key.options = tilePass->kernelOptions | (tilePass->marianiSilver ? int(TileKey::MarianiSilver) : 0);
+
+        //--只有完整的分块才放入缓存; 不完整的分块可以取缓存中对应的部分
+        cacheable = left == tileLeft && top == tileTop
+                && right - left == TileSize && bottom - top == TileSize;
+
+        if (loadCachedTile(key, tileLeft, tileTop, left, top, right, bottom)) {
+            ++counters.cacheHits;
+            cacheable = false;
+        } else {
+            ++counters.cacheMisses;
+        }
+    }
+
+    if (counters.cacheHits) {
+        //--缓存命中, 不必计算
+    } else if (tilePass->marianiSilver && step == 1) {
+        traceRect(tilePass, &counters, left, top, right, bottom);
+    } else {
+        //--逐行扫描, 预览层隔 step 行、step 列
+        for (int row = top; row < bottom; row += step) {
+
+            //--重启或终止
+            if (interrupted())
+                break;
+
+            iterateRow(tilePass, &counters, row, left, right, step);
+        }
+    }
+
+    //--帧预算到时也累加: 已算的分段保存在迭代状态中, 下一片不重算
+    tilePass->iteratedPixels.fetchAndAddRelaxed(counters.iteratedPixels);
+    tilePass->iterations.fetchAndAddRelaxed(counters.iterations);
+    tilePass->bulbPixels.fetchAndAddRelaxed(counters.bulbPixels);
+    tilePass->periodicPixels.fetchAndAddRelaxed(counters.periodicPixels);
+    tilePass->filledPixels.fetchAndAddRelaxed(counters.filledPixels);
+    tilePass->cacheHits.fetchAndAddRelaxed(counters.cacheHits);
+    tilePass->cacheMisses.fetchAndAddRelaxed(counters.cacheMisses);
+    tilePass->glitchedPixels.fetchAndAddRelaxed(counters.glitchedPixels);
+
+    if (interrupted())
+        return;
+
+    if (cacheable)
+        storeCachedTile(key, left, top);
+
+    if (step > 1)
+        colorPreviewTile(tilePass, left, top, right, bottom);
+}
+
+/*!
+ * \brief 区域内是否还有本轮需要迭代的像素
+ */
+bool RenderThread::tileNeedsWork(TilePass *tilePass, int left, int top, int right, int bottom) const
+{
+    for (int row = top; row < bottom; ++row) {
+        int offset = row * state.width;
+        for (int x = left; x < right; ++x) {
+            if (state.status[offset + x] == PixelUnresolved
+                    && state.iterations[offset + x] < tilePass->iterationLimit())
+                return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * \brief 从分块缓存取出世界分块, 复制与图像重叠的部分 [left, right) x [top, bottom)
+ * \param tileLeft,tileTop 世界分块左上角在图像中的位置(可能为负)
+ */
+bool RenderThread::loadCachedTile(const TileKey &key, int tileLeft, int tileTop,
+                                  int left, int top, int right, int bottom)
+{
+    TileData data;
+    if (!tileCache.lookup(key, &data))
+        return false;
+
+    int count = right - left;
+    for (int row = top; row < bottom; ++row) {
+        int to = row * state.width + left;
+        int from = (row - tileTop) * TileSize + (left - tileLeft);
+
+        memcpy(state.zr.data() + to, data.zr.constData() + from, count * sizeof(double));
+        memcpy(state.zi.data() + to, data.zi.constData() + from, count * sizeof(double));
+        memcpy(state.iterations.data() + to, data.iterations.constData() + from, count * sizeof(int));
+        memcpy(state.status.data() + to, data.status.constData() + from, count * sizeof(uchar));
+    }
+    return true;
+}
+
+/*!
+ * \brief 把算完本轮的完整分块放入缓存
+ */
+void RenderThread::storeCachedTile(const TileKey &key, int left, int top)
+{
+    const int size = TileSize * TileSize;
+
+    TileData data;
+    data.zr.resize(size);
+    data.zi.resize(size);
+    data.iterations.resize(size);
+    data.status.resize(size);
+
+    for (int row = 0; row < TileSize; ++row) {
+        int from = (top + row) * state.width + left;
+        int to = row * TileSize;
+
+        memcpy(data.zr.data() + to, state.zr.constData() + from, TileSize * sizeof(double));
+        memcpy(data.zi.data() + to, state.zi.constData() + from, TileSize * sizeof(double));
+        memcpy(data.iterations.data() + to, state.iterations.constData() + from, TileSize * sizeof(int));
+        memcpy(data.status.data() + to, state.status.constData() + from, TileSize * sizeof(uchar));
+    }
+
+    tileCache.insert(key, data);
+}
+
+/*!
+ * \brief 分段延长参考轨道到 maxIterations(或参考点逃逸), 多精度迭代很慢, 段间检查重启/终止
+ * \return 重启或终止时返回 false
  */
-uint RenderThread::rgbFromWaveLength(double wave)
-{
-    double r = 0.0;
-    double g = 0.0;
-    double b = 0.0;
-
-    if (wave >= 380.0 && wave <= 440.0) {
-        r = -1.0 * (wave - 440.0) / (440.0 - 380.0);
-        b = 1.0;
-    } else if (wave >= 440.0 && wave <= 490.0) {
-        g = (wave - 440.0) / (490.0 - 440.0);
-        b = 1.0;
-    } else if (wave >= 490.0 && wave <= 510.0) {
-        g = 1.0;
-        b = -1.0 * (wave - 510.0) / (510.0 - 490.0);
-    } else if (wave >= 510.0 && wave <= 580.0) {
-        r = (wave - 510.0) / (580.0 - 510.0);
-        g = 1.0;
-    } else if (wave >= 580.0 && wave <= 645.0) {
-        r = 1.0;
-        g = -1.0 * (wave - 645.0) / (645.0 - 580.0);
-    } else if (wave >= 645.0 && wave <= 780.0) {
-        r = 1.0;
+bool RenderThread::extendOrbit(ReferenceOrbit *orbit, int maxIterations)
+{
+    while (orbit->length() < maxIterations && !orbit->isEscaped()) {
+        if (interrupted())
+            return false;
+        orbit->extend(qMin(orbit->length() + int(OrbitChunk), maxIterations));
     }
+    return true;
+}
+
+/*!
+ * \brief 深度缩放: 本轮标记为失真的像素换参考点重算.
+ *        每次取一个失真像素为新参考点(它自身 δz 恒为 0, 必然算对), 计算其多精度轨道,
+ *        所有失真像素相对它从头迭代, 仍失真的留给下一个参考点
+ * \return 本轮用到的参考点数(含中心)
+ */
+int RenderThread::resolveGlitches(TilePass *tilePass)
+{
+    int references = 1;
+    QVector<int> glitched;
+
+    while (references < MaxReferences) {
+        glitched.clear();
+        for (int i = 0; i < state.status.size(); ++i) {
+            if (state.status[i] == PixelGlitched)
+                glitched.append(i);
+        }
+        if (glitched.isEmpty())
+            break;
+
+        //--取失真像素(按行排列)中间的一个, 大致位于失真区域内
+        int index = glitched[glitched.size() / 2];
+        int referenceX = index % state.width;
+        int referenceY = index / state.width;
+
+        ReferenceOrbit orbit;
+        orbit.reset(reference.centerX() + MpFloat((tilePass->x0 + referenceX) * tilePass->scaleFactor),
+                    reference.centerY() + MpFloat((tilePass->y0 + referenceY) * tilePass->scaleFactor));
+        if (!extendOrbit(&orbit, tilePass->maxIterations))
+            return references;
+        ++references;
+
+        PerturbationRow deltaState;
+        deltaState.referenceX = orbit.x();
+        deltaState.referenceY = orbit.y();
+        deltaState.referenceLength = orbit.length();
+        deltaState.scaleFactor = tilePass->scaleFactor;
+        deltaState.x0 = -referenceX;
+
+        for (int i = 0; i < glitched.size(); ++i) {
+            if (interrupted())
+                return references;
+
+            int x = glitched[i] % state.width;
+            int row = glitched[i] / state.width;
+            int offset = row * state.width;
 
-    double s = 1.0;
-    if (wave > 700.0)
-        s = 0.3 + 0.7 * (780.0 - wave) / (780.0 - 700.0);
-    else if (wave <  420.0)
-        s = 0.3 + 0.7 * (wave - 380.0) / (420.0 - 380.0);
+            deltaState.dcy = (row - referenceY) * tilePass->scaleFactor;
+            deltaState.zr = state.zr.data() + offset;
+            deltaState.zi = state.zi.data() + offset;
+            deltaState.iterations = state.iterations.data() + offset;
+            deltaState.status = state.status.data() + offset;
+
+            state.status[glitched[i]] = PixelUnresolved;
+            perturbationRow(deltaState, &x, 1, 0, tilePass->iterationLimit());
+
+            //--δz 相对这个参考点, 下一轮的中心参考轨道不能接着算, 从头开始
+            if (state.status[glitched[i]] == PixelUnresolved)
+                state.iterations[glitched[i]] = 0;
+        }
+    }
+
+    //--参考点用完仍失真的像素本轮按黑色, 下一轮从头重算
+    for (int i = 0; i < state.status.size(); ++i) {
+        if (state.status[i] == PixelGlitched) {
+            state.status[i] = PixelUnresolved;
+            state.iterations[i] = 0;
+        }
+    }
+
+    return references;
+}
+
+/*!
+ * \brief 一轮(含失真重算)结束后统计迭代状态: 逃逸 / 未确定的像素数, 本轮新逃逸像素的迭代次数分布
+ * \param rect 统计的区域: 真实渲染为整个视图, 推测为分块网格中真实视图所在的一块
+ */
+IterationSchedule::PassSummary RenderThread::summarizePass(const IterationSchedule &schedule,
+                                                           const QRect &rect) const
+{
+    IterationSchedule::PassSummary summary = IterationSchedule::PassSummary();
+    summary.pixels = qint64(rect.width()) * rect.height();
+
+    for (int row = rect.top(); row <= rect.bottom(); ++row) {
+        int offset = row * state.width;
+        for (int i = offset + rect.left(); i <= offset + rect.right(); ++i) {
+            if (state.status[i] == PixelEscaped) {
+                ++summary.escapedPixels;
+                int bin = schedule.bin(state.iterations[i]);
+                if (bin >= 0)
+                    ++summary.histogram[bin];
+            } else if (state.status[i] == PixelUnresolved) {
+                ++summary.unresolvedPixels;
+            }
+        }
+    }
+    return summary;
+}
+
+/*!
+ * \brief 共轭对称: [rowTop, rowBottom) 之外的行复制实轴另一侧的对应行 2 * axisRow - row,
+ *        迭代次数和状态相同, z 取共轭(double-double 的低位部分同样取反)
+ * \return 复制的像素数
+ */
+int RenderThread::mirrorRows(TilePass *tilePass)
+{
+    int mirrored = 0;
+    for (int row = 0; row < tilePass->height; ++row) {
+        if (row >= tilePass->rowTop && row < tilePass->rowBottom)
+            continue;
+
+        int to = row * state.width;
+        int from = (2 * tilePass->axisRow - row) * state.width;
+        memcpy(state.zr.data() + to, state.zr.constData() + from, state.width * sizeof(double));
+        memcpy(state.zrLo.data() + to, state.zrLo.constData() + from, state.width * sizeof(double));
+        memcpy(state.iterations.data() + to, state.iterations.constData() + from, state.width * sizeof(int));
+        memcpy(state.status.data() + to, state.status.constData() + from, state.width * sizeof(uchar));
+        for (int x = 0; x < state.width; ++x) {
+            state.zi[to + x] = -state.zi[from + x];
+            state.ziLo[to + x] = -state.ziLo[from + x];
+        }
+        mirrored += state.width;
+    }
+    return mirrored;
+}
 
-    r = std::pow(r * s, 0.8);
-    g = std::pow(g * s, 0.8);
-    b = std::pow(b * s, 0.8);
-    return qRgb(int(r * 255), int(g * 255), int(b * 255));
+/*!
+ * \brief 空闲推测一个视图: 按 run() 中分块缓存的网格对齐, 算出视图覆盖的整个世界分块区域,
+ *        每轮算完的分块放入缓存; 不上色、不发布.
+ *        各轮上限按真实渲染的方式确定: 起点按 viewSize 的宽度, 自适应统计只取分块网格中
+ *        以 viewSize 居中的一块, 真实渲染同一视图时各轮上限相同, 分块逐轮命中;
+ *        平移邻近区域在平移后统计的像素不同, 自适应的选择可能不同, 之后的轮次不一定命中.
+ *        用 speculativeState 作迭代状态, 当前视图的迭代状态换出保留(平移复用和重新上色仍然有效)
+ * \return 算完(或超出缓存份额、精度不使用缓存)返回 true, 被打断返回 false
+ */
+bool RenderThread::speculate(const SpeculativeView &view, int options, int maxIterations)
+{
+    int halfWidth = view.size.width() / 2;
+    int halfHeight = view.size.height() / 2;
+    QSize viewSize = view.viewSize.isEmpty() ? view.size : view.viewSize;
+    int viewHalfWidth = qMin(viewSize.width() / 2, halfWidth);
+    int viewHalfHeight = qMin(viewSize.height() / 2, halfHeight);
+    double centerX = view.centerX.toDouble();
+    double centerY = view.centerY.toDouble();
+    if (viewHalfWidth <= 0 || viewHalfHeight <= 0 || view.scaleFactor <= 0)
+        return true;
+
+    //--与 run() 相同: 只有选中 double 及以下精度时才使用分块缓存
+    double magnitude = qMax(qAbs(centerX), qAbs(centerY))
+            + qMax(viewHalfWidth, viewHalfHeight) * view.scaleFactor;
+    KernelPrecision precision = selectPrecision(magnitude, view.scaleFactor,
+                                                qint64(2 * viewHalfWidth) * (2 * viewHalfHeight), kernelIsa);
+    if ((options & DeepZoom) || precision > PrecisionDouble)
+        return true;
+
+    //--视图左上角的世界像素, 以及覆盖视图的世界分块
+    qint64 scaleKey = TileCache::scaleKey(view.scaleFactor);
+    double gridScale = TileCache::scaleForKey(scaleKey);
+    double x0 = double(qRound64(centerX / gridScale) - halfWidth);
+    double y0 = double(qRound64(centerY / gridScale) - halfHeight);
+    qint64 tileIndexX = qint64(std::floor(x0 / TileSize));
+    qint64 tileIndexY = qint64(std::floor(y0 / TileSize));
+    int tileColumns = int(qint64(std::floor((x0 + 2 * halfWidth - 1) / TileSize)) - tileIndexX + 1);
+    int tileRows = int(qint64(std::floor((y0 + 2 * halfHeight - 1) / TileSize)) - tileIndexY + 1);
+
+    //--真实视图在分块网格中的位置, 与 run() 的 x0 / y0 取整相同
+    QRect viewRect(int(qRound64(centerX / gridScale) - viewHalfWidth - tileIndexX * TileSize),
+                   int(qRound64(centerY / gridScale) - viewHalfHeight - tileIndexY * TileSize),
+                   2 * viewHalfWidth, 2 * viewHalfHeight);
+
+    qint64 budgetTiles = tileCache.capacityBytes() / SpeculationShare / TileCache::tileBytes();
+    qint64 storedTiles = 0;
+
+    qSwap(state, speculativeState);
+    state.reset(tileColumns * TileSize, tileRows * TileSize);
+    state.originX = MpFloat(double(tileIndexX * TileSize) * gridScale);
+    state.originY = MpFloat(double(tileIndexY * TileSize) * gridScale);
+    state.scaleFactor = gridScale;
+    state.options = options;
+    state.precision = PrecisionDouble;
+
+    sliceDeadlineNs = 0;
+
+    IterationSchedule schedule;
+    schedule.start(view.scaleFactor, 2 * viewHalfWidth, maxIterations, options & AdaptiveIterations);
+    bool finished = true;
+
+    while (!schedule.isFinished() && storedTiles < budgetTiles) {
+        TilePass tilePass;
+        tilePass.bits = nullptr;
+        tilePass.bytesPerLine = 0;
+        tilePass.width = state.width;
+        tilePass.height = state.height;
+        tilePass.centerX = 0;
+        tilePass.centerY = 0;
+        tilePass.scaleFactor = gridScale;
+        tilePass.x0 = double(tileIndexX * TileSize);
+        tilePass.y0 = double(tileIndexY * TileSize);
+        tilePass.maxIterations = schedule.limit();
+        tilePass.sampleStep = 1;
+        tilePass.colorOffset = 0;
+        tilePass.rowTop = 0;
+        tilePass.rowBottom = state.height;
+        tilePass.axisRow = 0;
+        tilePass.tileCaching = true;
+        tilePass.tileOffsetX = 0;
+        tilePass.tileOffsetY = 0;
+        tilePass.tileIndexX = tileIndexX;
+        tilePass.tileIndexY = tileIndexY;
+        tilePass.scaleKey = scaleKey;
+        tilePass.tileColumns = tileColumns;
+        tilePass.tileCount = tileColumns * tileRows;
+        tilePass.nextTile.storeRelease(0);
+        tilePass.allBlack.storeRelease(1);
+        tilePass.kernelOptions = (options & InteriorChecks)
+                ? EscapeTimeCardioid | EscapeTimePeriodicity : 0;
+        tilePass.marianiSilver = options & MarianiSilver;
+        tilePass.escapeTimeRow = escapeTimeRow;
+        tilePass.juliaX = 0;
+        tilePass.juliaY = 0;
+        tilePass.reference = nullptr;
+        tilePass.precisionRow = nullptr;
+
+        //--分块全部交给推测线程池, 以最低优先级只占用空闲的 CPU; 渲染线程不降优先级, 只等待
+        for (int i = 0; i < workerCount; ++i)
+            speculationPool.start(new SpeculationRunnable(this, &tilePass));
+        speculationPool.waitForDone();
+
+        if (interrupted()) {
+            finished = false;
+            break;
+        }
+        storedTiles += tilePass.cacheMisses.loadAcquire();
+
+        //--与 run() 相同: 第一轮(真实视图内)全黑时跳过几轮
+        IterationSchedule::PassSummary summary = summarizePass(schedule, viewRect);
+        bool black = schedule.pass() == 0 && summary.escapedPixels == 0;
+        schedule.finishPass(summary);
+        if (black)
+            schedule.skipBlack();
+    }
+
+    qSwap(state, speculativeState);
+
+    mutex.lock();
+    speculation.tiles += storedTiles;
+    mutex.unlock();
+    return finished;
+}
+
+/*!
+ * \brief 迭代一行中 [left, right) 内每隔 step 列、本轮尚未算到 iterationLimit() 的像素
+ *        未逃逸像素按已迭代次数分组送入内核: 0 为从头开始(新像素, 或 Mariani-Silver 填充过、没有 z),
+ *        其余从保存的 z 继续(上一轮算到上限, 或平移前的请求算到的轮次)
+ */
+void RenderThread::iterateRow(TilePass *tilePass, TileCounters *counters,
+                              int row, int left, int right, int step)
+{
+    int offset = row * state.width;
+
+    /// \brief 待迭代像素的列号
+    int pending[TileSize];
+    int count = 0;
+
+    for (int x = left; x < right; x += step) {
+        if (state.status[offset + x] == PixelUnresolved
+                && state.iterations[offset + x] < tilePass->iterationLimit())
+            pending[count++] = x;
+    }
+
+    EscapeTimeRow rowState;
+    rowState.centerX = tilePass->centerX;
+    rowState.scaleFactor = tilePass->scaleFactor;
+
+    ///--虚部
+    rowState.ay = tilePass->centerY + ((tilePass->y0 + row) * tilePass->scaleFactor);
+    rowState.x0 = tilePass->x0;
+    rowState.zr = state.zr.data() + offset;
+    rowState.zi = state.zi.data() + offset;
+    rowState.iterations = state.iterations.data() + offset;
+    rowState.status = state.status.data() + offset;
+    rowState.options = tilePass->kernelOptions;
+    rowState.juliaX = tilePass->juliaX;
+    rowState.juliaY = tilePass->juliaY;
+
+    //--深度缩放: δc = ((x0 + x) * scaleFactor, (y0 + row) * scaleFactor), 相对中心参考点
+    PerturbationRow deltaState;
+    if (tilePass->reference) {
+        deltaState.referenceX = tilePass->reference->x();
+        deltaState.referenceY = tilePass->reference->y();
+        deltaState.referenceLength = tilePass->reference->length();
+        deltaState.scaleFactor = tilePass->scaleFactor;
+        deltaState.x0 = tilePass->x0;
+        deltaState.dcy = (tilePass->y0 + row) * tilePass->scaleFactor;
+        deltaState.zr = rowState.zr;
+        deltaState.zi = rowState.zi;
+        deltaState.iterations = rowState.iterations;
+        deltaState.status = rowState.status;
+    }
+
+    //--float / double-double / 定点数: 行的虚部多精度相加, 内核再转换为自己的数值类型
+    PrecisionRow preciseState;
+    if (tilePass->precisionRow) {
+        preciseState.centerX = tilePass->preciseCenterX;
+        preciseState.ay = tilePass->preciseCenterY + MpFloat((tilePass->y0 + row) * tilePass->scaleFactor);
+        preciseState.scaleFactor = tilePass->scaleFactor;
+        preciseState.x0 = tilePass->x0;
+        preciseState.zr = rowState.zr;
+        preciseState.zi = rowState.zi;
+        preciseState.zrLo = state.zrLo.data() + offset;
+        preciseState.ziLo = state.ziLo.data() + offset;
+        preciseState.iterations = rowState.iterations;
+        preciseState.status = rowState.status;
+        preciseState.options = tilePass->kernelOptions;
+    }
+
+    counters->iteratedPixels += count;
+
+    while (count > 0) {
+
+        //--重启或终止: 已算的分段都保存了 z 和迭代次数, 平移复用时接着算
+        if (interrupted())
+            return;
+
+        //--取出与第一个像素已迭代次数相同的一组, 其余留到下一组
+        int startIteration = rowState.iterations[pending[0]];
+        int columns[TileSize];
+        int group = 0;
+        int rest = 0;
+        for (int i = 0; i < count; ++i) {
+            if (rowState.iterations[pending[i]] == startIteration)
+                columns[group++] = pending[i];
+            else
+                pending[rest++] = pending[i];
+        }
+        count = rest;
+
+        //--分段迭代: 一组每段约 CancelCheckIterations 次像素迭代, 段间检查重启/终止;
+        //--内核从保存的 z 继续, 分段不改变逃逸像素的迭代次数
+        int slice = qMax(int(CancelCheckIterations) / group, int(MinCancelSlice));
+        int limit = tilePass->iterationLimit() - startIteration > slice
+                ? startIteration + slice : tilePass->iterationLimit();
+
+        //--单个像素点处,迭代计算 Mandelbrot 集: Z(n+1)=(Zn)^2+C(或所选分形的公式)
+        //--SIMD 内核一次迭代 2/4/8 个像素
+        if (tilePass->reference)
+            perturbationRow(deltaState, columns, group, startIteration, limit);
+        else if (tilePass->precisionRow)
+            tilePass->precisionRow(preciseState, columns, group, startIteration, limit);
+        else
+            tilePass->escapeTimeRow(rowState, columns, group, startIteration, limit);
+
+        for (int i = 0; i < group; ++i) {
+            int x = columns[i];
+            counters->iterations += rowState.iterations[x] - startIteration;
+
+            //--算到本段上限仍未确定的像素, 留到下一段
+            if (limit < tilePass->iterationLimit() && rowState.status[x] == PixelUnresolved)
+                pending[count++] = x;
+
+            if (rowState.status[x] == PixelInsideBulb)
+                ++counters->bulbPixels;
+            else if (rowState.status[x] == PixelPeriodic)
+                ++counters->periodicPixels;
+            else if (rowState.status[x] == PixelGlitched)
+                ++counters->glitchedPixels;
+        }
+    }
+}
+
+/*!
+ * \brief 像素的"颜色值": 逃逸像素为迭代次数, 其余(黑色)为 -1;
+ *        失真像素颜色未知, 为 -2, 所在矩形不会被填充
+ */
+inline int RenderThread::dwell(int index) const
+{
+    if (state.status[index] == PixelEscaped)
+        return state.iterations[index];
+    return state.status[index] == PixelGlitched ? -2 : -1;
+}
+
+/*!
+ * \brief Mariani-Silver 矩形细分: 集合是连通的, 边界上颜色值全部相同的矩形,
+ *        内部也是同一颜色值, 直接填充; 否则四分(子矩形共用分割线)递归
+ * \param left,top,right,bottom 矩形 [left, right) x [top, bottom)
+ */
+void RenderThread::traceRect(TilePass *tilePass, TileCounters *counters,
+                             int left, int top, int right, int bottom)
+{
+    if (interrupted())
+        return;
+
+    //--矩形太小, 细分不划算, 逐行算完
+    if (right - left <= MinTraceSize || bottom - top <= MinTraceSize) {
+        for (int row = top; row < bottom; ++row)
+            iterateRow(tilePass, counters, row, left, right);
+        return;
+    }
+
+    //--边界: 上下两行, 左右两列
+    iterateRow(tilePass, counters, top, left, right);
+    iterateRow(tilePass, counters, bottom - 1, left, right);
+    for (int row = top + 1; row < bottom - 1; ++row) {
+        iterateRow(tilePass, counters, row, left, left + 1);
+        iterateRow(tilePass, counters, row, right - 1, right);
+    }
+
+    //--重启或终止时边界可能没算完, 不能据此填充
+    if (interrupted())
+        return;
+
+    int value = dwell(top * state.width + left);
+    bool uniform = true;
+    for (int x = left; x < right && uniform; ++x) {
+        uniform = dwell(top * state.width + x) == value
+                && dwell((bottom - 1) * state.width + x) == value;
+    }
+    for (int row = top + 1; row < bottom - 1 && uniform; ++row) {
+        uniform = dwell(row * state.width + left) == value
+                && dwell(row * state.width + right - 1) == value;
+    }
+
+    if (uniform) {
+        //--逃逸像素填为同一迭代次数, z 记为 2 + 0i(|z|^2 = 4, 平滑着色不读到上一帧留下的 z);
+        //--黑色像素标记为从头开始, 下一轮再由边界决定是否需要计算
+        for (int row = top + 1; row < bottom - 1; ++row) {
+            int offset = row * state.width;
+            for (int x = left + 1; x < right - 1; ++x) {
+                state.status[offset + x] = value >= 0 ? PixelEscaped : PixelUnresolved;
+                state.iterations[offset + x] = qMax(value, 0);
+                state.zr[offset + x] = 2.0;
+                state.zi[offset + x] = 0.0;
+            }
+        }
+        counters->filledPixels += qint64(right - left - 2) * (bottom - top - 2);
+        return;
+    }
+
+    int midX = (left + right) / 2;
+    int midY = (top + bottom) / 2;
+    traceRect(tilePass, counters, left, top, midX + 1, midY + 1);
+    traceRect(tilePass, counters, midX, top, right, midY + 1);
+    traceRect(tilePass, counters, left, midY, midX + 1, bottom);
+    traceRect(tilePass, counters, midX, midY, right, bottom);
+}
+
+/*!
+ * \brief 取当前上色设置; 调色板改变时重新生成颜色空间(只在没有线程读它时调用)
+ */
+ColorMap RenderThread::colorSettings()
+{
+    mutex.lock();
+    Palette palette = this->palette;
+    ColorMap map;
+    map.colors = colormap;
+    map.offset = colorOffset;
+    map.options = colorOptions;
+    map.levels = nullptr;
+    map.levelCount = 0;
+    recolor = false;
+    mutex.unlock();
+
+    if (palette != colormapPalette) {
+        colormapPalette = palette;
+        fillPalette(colormapPalette, colormap);
+    }
+    return map;
+}
+
+/*!
+ * \brief 按迭代状态整幅上色, 线程池工作线程和本线程一起按行块领取;
+ *        直方图均衡先统计逃逸像素的迭代次数分布
+ * \return 是否有逃逸像素(非全黑)
+ */
+bool RenderThread::colorImage(uchar *bits, int bytesPerLine)
+{
+    ColorPass colorPass;
+    colorPass.bits = bits;
+    colorPass.bytesPerLine = bytesPerLine;
+    colorPass.map = colorSettings();
+    colorPass.nextRow.storeRelease(0);
+    colorPass.allBlack.storeRelease(1);
+
+    QVector<int> levels;
+    if (colorPass.map.options & ColorEqualize) {
+        int size = state.width * state.height;
+        int maxDwell = 0;
+        for (int i = 0; i < size; ++i) {
+            if (state.status[i] == PixelEscaped)
+                maxDwell = qMax(maxDwell, state.iterations[i]);
+        }
+
+        QVector<int> histogram(maxDwell + 1, 0);
+        for (int i = 0; i < size; ++i) {
+            if (state.status[i] == PixelEscaped)
+                ++histogram[state.iterations[i]];
+        }
+
+        levels.resize(histogram.size());
+        equalizeLevels(histogram.constData(), histogram.size(), levels.data());
+        colorPass.map.levels = levels.constData();
+        colorPass.map.levelCount = levels.size();
+    }
+
+    for (int i = 1; i < workerCount; ++i)
+        pool.start(new ColorRunnable(this, &colorPass));
+    colorRows(&colorPass);
+    pool.waitForDone();
+
+    return !colorPass.allBlack.loadAcquire();
+}
+
+/*!
+ * \brief 上色线程循环: 每次领取 ColorRows 行, 直到领完
+ */
+void RenderThread::colorRows(ColorPass *colorPass)
+{
+    QElapsedTimer busyTimer;
+    busyTimer.start();
+
+    forever {
+        int top = colorPass->nextRow.fetchAndAddRelaxed(ColorRows);
+        if (top >= state.height)
+            break;
+
+        int bottom = qMin(top + int(ColorRows), state.height);
+        bool escaped = false;
+        for (int row = top; row < bottom; ++row) {
+            int offset = row * state.width;
+
+            ColorRow line;
+            line.iterations = state.iterations.constData() + offset;
+            line.status = state.status.constData() + offset;
+            line.zr = state.zr.constData() + offset;
+            line.zi = state.zi.constData() + offset;
+            line.pixels = reinterpret_cast<uint *>(colorPass->bits + row * colorPass->bytesPerLine);
+
+            //--逃逸像素取调色板颜色, 其余黑色; AVX2 / AVX-512 一次 8 / 16 个像素
+            escaped |= colorRow(colorPass->map, line, state.width);
+        }
+
+        if (escaped)
+            colorPass->allBlack.storeRelease(0);
+    }
+
+    busyNs.fetchAndAddRelaxed(busyTimer.nsecsElapsed());
+}
+
+/*!
+ * \brief 预览层上色: 以 (left, top) 为原点每隔 sampleStep 的采样点, 颜色填满它右下方的 step x step 块
+ */
+void RenderThread::colorPreviewTile(TilePass *tilePass, int left, int top, int right, int bottom)
+{
+    int step = tilePass->sampleStep;
+    bool allBlack = true;
+
+    for (int sampleRow = top; sampleRow < bottom; sampleRow += step) {
+        int offset = sampleRow * state.width;
+        int blockBottom = qMin(sampleRow + step, bottom);
+
+        for (int x = left; x < right; x += step) {
+            uint color = qRgb(0, 0, 0);
+            if (state.status[offset + x] == PixelEscaped) {
+                color = colormap[(state.iterations[offset + x] + tilePass->colorOffset) & (PaletteSize - 1)];
+                allBlack = false;
+            }
+
+            int blockRight = qMin(x + step, right);
+            for (int row = sampleRow; row < blockBottom; ++row) {
+                uint *scanLine = reinterpret_cast<uint *>(tilePass->bits + row * tilePass->bytesPerLine);
+                for (int column = x; column < blockRight; ++column)
+                    scanLine[column] = color;
+            }
+        }
+    }
+
+    if (!allBlack)
+        tilePass->allBlack.storeRelease(0);
+}
+
+/*!
+ * \brief 按图像大小重新分配, 所有像素标记为未计算
+ */
+void RenderThread::IterationBuffer::reset(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+
+    int size = width * height;
+    zr.resize(size);
+    zi.resize(size);
+    zrLo.resize(size);
+    ziLo.resize(size);
+    iterations.fill(0, size);
+    status.fill(PixelUnresolved, size);
+}
+
+/*!
+ * \brief 缩放、大小、选项都不变, 中心只移动整数个像素(滚动)时, 把迭代状态平移到新位置,
+ *        新露出的行列标记为未计算; 保留的像素已算到的轮次不必重算
+ * \return 不是纯平移返回 false, 缓冲区不变
+ */
+bool RenderThread::IterationBuffer::translate(const MpFloat &originX, const MpFloat &originY,
+                                              double scaleFactor, int width, int height,
+                                              int options, int precision, const Fractal &fractal)
+{
+    //--不同精度的内核 z 的保存格式不同, 不同分形的 z 不能接着迭代
+    if (scaleFactor != this->scaleFactor || width != this->width || height != this->height
+            || options != this->options || precision != this->precision || fractal != this->fractal)
+        return false;
+
+    //--新图像 (x, y) 处的像素是旧图像的 (x + dx, y + dy)
+    double shiftX = (originX - this->originX).toDouble() / scaleFactor;
+    double shiftY = (originY - this->originY).toDouble() / scaleFactor;
+    if (qAbs(shiftX) >= width || qAbs(shiftY) >= height)
+        return false;
+
+    int dx = qRound(shiftX);
+    int dy = qRound(shiftY);
+
+    //--中心是 scroll() 按整数像素累加的, 只差舍入误差
+    const double MaxShiftError = 1e-3;
+    if (qAbs(shiftX - dx) > MaxShiftError || qAbs(shiftY - dy) > MaxShiftError)
+        return false;
+
+    if (dx == 0 && dy == 0)
+        return true;
+
+    int size = width * height;
+    QVector<double> movedZr(size);
+    QVector<double> movedZi(size);
+    QVector<double> movedZrLo(size);
+    QVector<double> movedZiLo(size);
+    QVector<int> movedIterations(size, 0);
+    QVector<uchar> movedStatus(size, uchar(PixelUnresolved));
+
+    int left = qMax(0, -dx);
+    int right = qMin(width, width - dx);
+    for (int y = qMax(0, -dy); y < qMin(height, height - dy); ++y) {
+        int to = y * width + left;
+        int from = (y + dy) * width + left + dx;
+        int count = right - left;
+
+        memcpy(movedZr.data() + to, zr.constData() + from, count * sizeof(double));
+        memcpy(movedZi.data() + to, zi.constData() + from, count * sizeof(double));
+        memcpy(movedZrLo.data() + to, zrLo.constData() + from, count * sizeof(double));
+        memcpy(movedZiLo.data() + to, ziLo.constData() + from, count * sizeof(double));
+        memcpy(movedIterations.data() + to, iterations.constData() + from, count * sizeof(int));
+        memcpy(movedStatus.data() + to, status.constData() + from, count * sizeof(uchar));
+    }
+
+    zr.swap(movedZr);
+    zi.swap(movedZi);
+    zrLo.swap(movedZrLo);
+    ziLo.swap(movedZiLo);
+    iterations.swap(movedIterations);
+    status.swap(movedStatus);
+
+    //--深度缩放: 未逃逸像素的 δz 相对旧中心, 参考点随中心移动后不能接着算, 从头开始
+    if (options & DeepZoom) {
+        for (int i = 0; i < size; ++i) {
+            if (status[i] != PixelEscaped)
+                iterations[i] = 0;
+        }
+    }
+    return true;
 }
-//! [10]
@@ -51,11 +51,25 @@
 #ifndef RENDERTHREAD_H
 #define RENDERTHREAD_H
 
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QMutex>
+#include <QRect>
 #include <QSize>
 #include <QThread>
+#include <QThreadPool>
+#include <QVector>
 #include <QWaitCondition>
 
+#include "colorize.h"
+#include "fractalkernel.h"
+#include "framering.h"
+#include "iterationschedule.h"
+#include "mandelbrotkernel.h"
+#include "perturbation.h"
+#include "precisionkernel.h"
+#include "tilecache.h"
+
 QT_BEGIN_NAMESPACE
 class QImage;
 QT_END_NAMESPACE
@@ -66,34 +80,418 @@ class RenderThread : public QThread
     Q_OBJECT
 
 public:
+    /*!
+     * \brief 渲染选项, 可组合
+     */
+    enum RenderOption {
+        InteriorChecks = 0x1,   //--主心形/周期 2 圆盘判定和周期检测, 内部点不必迭代到上限
+        MarianiSilver = 0x2,    //--Mariani-Silver 矩形细分, 边界一致的矩形直接填充
+        TileCaching = 0x4,      //--分块缓存, 缩放量化并对齐世界像素网格
+        DeepZoom = 0x8,         //--强制微扰深度缩放; 否则按缩放和图像大小自动选择内核精度(selectPrecision)
+        Preview = 0x10,         //--迭代状态作废时, 第一轮之前先按 1/8、1/4、1/2 分辨率各出一帧预览
+        AdaptiveIterations = 0x20,  //--每轮上限按缩放深度和逃逸统计自适应, 新逃逸像素很少时提前结束(IterationSchedule)
+        ConjugateSymmetry = 0x40,   //--视图跨过实轴时行对齐到实轴, 实轴一侧较少的行由另一侧镜像
+        Speculation = 0x80          //--空闲时以最低优先级推测计算 setSpeculativeViews() 的视图放入分块缓存(需要 TileCaching)
+    };
+
+    /*!
+     * \brief 当前渲染请求的统计, 各轮累加
+     */
+    struct Statistics
+    {
+        int passes;                 //--已完成的轮数
+        int maxIterations;          //--最后一轮的最大迭代次数
+        qint64 savedIterations;     //--自适应提前结束时, 相对算到设置的上限估算省下的迭代次数
+        qint64 pixels;              //--图像像素数
+        qint64 iteratedPixels;      //--各轮送入内核的像素数之和
+        qint64 iterations;          //--各轮实际迭代次数之和
+        qint64 bulbPixels;          //--主心形/周期 2 圆盘判定的像素
+        qint64 periodicPixels;      //--周期检测提前结束的像素
+        qint64 filledPixels;        //--Mariani-Silver 未迭代直接填充的像素
+        qint64 mirroredPixels;      //--各轮由实轴另一侧镜像、未计算的像素
+        qint64 cacheHits;           //--从分块缓存取得的分块
+        qint64 cacheMisses;         //--缓存未命中、需要计算的分块
+        KernelIsa isa;              //--内核指令集
+        KernelPrecision precision;  //--内核精度
+        int references;             //--最后一轮用到的参考点数(含中心)
+        qint64 glitchedPixels;      //--各轮失真、换参考点重算的像素
+        qint64 handoffNs;           //--各轮取得/发布帧环缓冲区的耗时(不复制图像, 只在大小改变时分配)
+        qint64 colorNs;             //--最近一次整幅上色的耗时(迭代之外的单独一步)
+        int previewLevels;          //--已发布的低分辨率预览帧
+        qint64 firstFrameMs;        //--从请求开始到发布第一帧(预览或第一轮)的耗时
+        int budgetFrames;           //--帧预算模式: 到截止时间、本轮没算完就发布的帧
+        qint64 frameIntervalUs;     //--相邻两次发布的平均间隔(第一帧从请求开始算)
+        qint64 frameJitterUs;       //--发布间隔的标准差
+        qint64 maxFrameIntervalUs;  //--最长的发布间隔
+        int cpuPercent;             //--工作线程分块和上色的时间 / (墙钟时间 x CPU 核数)
+        qint64 elapsedMs;           //--从请求开始到最后一轮结束的耗时
+    };
+
+    /*!
+     * \brief 空闲时推测计算的视图(如下一级放大、平移后的邻近区域)
+     */
+    struct SpeculativeView
+    {
+        MpFloat centerX;
+        MpFloat centerY;
+        double scaleFactor;
+        QSize size;
+        QSize viewSize;             //--真实渲染时的视图大小(平移邻近区域的 size 比视图大), 为空时同 size
+    };
+
+    /*!
+     * \brief 推测的统计, 从构造起累加
+     */
+    struct SpeculationCounters
+    {
+        qint64 views;               //--开始推测的视图
+        qint64 preempted;           //--被新的请求打断的视图
+        qint64 tiles;               //--推测算出并放入缓存的分块(各轮分别计)
+        qint64 viewHits;            //--真实渲染全分辨率各轮的分块缓存命中
+        qint64 viewMisses;          //--真实渲染全分辨率各轮的分块缓存未命中
+    };
+
+    /// \brief 默认最大迭代次数, 即第 8 轮的上限
+    enum { DefaultMaxIterations = (1 << 20) + 32 };
+
     RenderThread(QObject *parent = 0);
     ~RenderThread();
 
-    void render(double centerX, double centerY, double scaleFactor, QSize resultSize);
+    qint64 render(const MpFloat &centerX, const MpFloat &centerY, double scaleFactor, QSize resultSize);
+
+    /*!
+     * \brief 设置渲染选项(RenderOption), 下一次 render() 起生效
+     */
+    void setOptions(int options);
+
+    /*!
+     * \brief 设置最大迭代次数, 下一次 render() 起生效; 每轮上限翻 4 倍(或自适应), 达到此值的一轮为最后一轮
+     */
+    void setMaxIterations(int maxIterations);
+
+    /*!
+     * \brief 设置渲染线程数(含渲染线程自身), 下一次 render() 起生效, 默认 CPU 核数
+     */
+    void setThreadCount(int threadCount);
+
+    /*!
+     * \brief 帧预算模式, 下一次 render() 起生效: 每帧最多算 milliseconds 毫秒(含上色),
+     *        到截止时间发布已逃逸的部分, 下一片从保存的迭代状态继续; 最多用 threads 个线程
+     *        (含渲染线程, 不超过 setThreadCount()), 不占满 CPU; milliseconds 为 0 关闭
+     */
+    void setFrameBudget(int milliseconds, int threads);
+
+    /*!
+     * \brief 设置要渲染的分形, 下一次 render() 起生效, 默认 Mandelbrot;
+     *        其他分形只有 double 内核(不换精度、不微扰), 不使用分块缓存和推测,
+     *        集合不连通时不用 Mariani-Silver, 不对称时不镜像; 幂次限制在 3..8
+     */
+    void setFractal(const Fractal &fractal);
+
+    /*!
+     * \brief 渲染完成后空闲时按顺序推测计算的视图, 替换之前未算的; render() 时清空.
+     *        按真实渲染的分块网格和各轮上限算出世界分块放入分块缓存, 之后真正请求这些视图时直接命中
+     *        (自适应轮次按 viewSize 大小的视图统计; 平移后统计的像素不同, 自适应的后续轮次可能不命中);
+     *        分块在推测专用的线程池中以最低优先级计算, 新的请求或设置到来时在迭代分段之间立即停止;
+     *        每个视图放入缓存的分块不超过缓存容量的 1/SpeculationShare
+     */
+    void setSpeculativeViews(const QVector<SpeculativeView> &views);
+
+    SpeculationCounters speculationCounters();
+
+    /*!
+     * \brief 上色设置: 调色板, ColorOption 组合, 循环变色的调色板偏移;
+     *        渲染中从下一轮起生效, 空闲时用最后一轮的迭代状态立即重新上色并发布, 不重新迭代
+     */
+    void setPalette(Palette palette);
+    void setColorOptions(int colorOptions);
+    void setColorOffset(int colorOffset);
+
+    Statistics statistics();
+
+    TileCache::Counters tileCacheCounters();
+
+    /*!
+     * \brief 最近一次渲染完成(renderFinished())时每个像素的迭代次数, 未逃逸(黑色)为 -1, 按行排列;
+     *        渲染线程在最后一轮结束时保存快照, 之后的空闲推测不影响
+     */
+    QVector<int> iterationMap();
+
+    /*!
+     * \brief 每轮的图像发布在帧环中, 界面线程(或其他唯一的读端)用 acquire() 取最新一帧
+     */
+    FrameRing *frameRing() { return &frames; }
 
 signals:
 
     /*!
-     * \brief 传递图像引用
-     * \param image
-     * \param scaleFactor
+     * \brief 一轮的图像已发布到帧环; 读端来不及处理时多个通知只需取一次最新帧
+     */
+    void frameReady();
+
+    /*!
+     * \brief 当前渲染请求的最后一轮完成, 在 frameReady() 之后发出; statistics() 为这一帧的统计
      */
-    void renderedImage(const QImage &image, double scaleFactor);
+    void renderFinished();
 
 protected:
     void run() override;
 
 private:
-    uint rgbFromWaveLength(double wave);
+    /*!
+     * \brief 一轮(pass)的分块渲染参数, 所有工作线程共享
+     */
+    struct TilePass
+    {
+        uchar *bits;
+        int bytesPerLine;
+        int width;
+        int height;
+
+        ///--像素 (x, y) 处 C = (centerX + (x0 + x) * scaleFactor, centerY + (y0 + y) * scaleFactor)
+        double centerX;
+        double centerY;
+        double scaleFactor;
+        double x0;
+        double y0;
+
+        int maxIterations;
+        int sampleStep;         //--预览层的采样间隔 8/4/2, 全分辨率为 1
+        int colorOffset;        //--预览层按块上色用的调色板偏移
+
+        ///--内核迭代的上限: 与原来的逐像素循环相同, 恰好第 maxIterations 次才逃逸的像素按黑色,
+        ///--所以本轮最多迭代 maxIterations - 1 次; 下一轮从这里继续, 逃逸像素的迭代次数不变
+        int iterationLimit() const { return maxIterations - 1; }
+
+        ///--共轭对称: 本轮计算 [rowTop, rowBottom) 行, 其余行镜像自 2 * axisRow - row; 不镜像时为整幅
+        int rowTop;
+        int rowBottom;
+        int axisRow;
+        int tileColumns;
+        int tileCount;
+
+        ///--分块缓存: 分块网格相对图像左上角的偏移, 第 0 个分块的世界分块坐标
+        bool tileCaching;
+        int tileOffsetX;
+        int tileOffsetY;
+        qint64 tileIndexX;
+        qint64 tileIndexY;
+        qint64 scaleKey;
+
+        QAtomicInt nextTile;    //--下一个待领取的分块
+        QAtomicInt allBlack;    //--本轮是否全黑(任一像素在轮廓外则清零)
+        int kernelOptions;      //--EscapeTimeOption
+        bool marianiSilver;
+
+        ///--深度缩放时的参考轨道(参考点为中心), 否则为 nullptr
+        const ReferenceOrbit *reference;
+
+        ///--double 内核(按分形选择)和 Julia 集的常数
+        EscapeTimeRowFunction escapeTimeRow;
+        double juliaX;
+        double juliaY;
+
+        ///--float / double-double / 定点数内核, 中心为多精度; double 和微扰时为 nullptr
+        PrecisionRowFunction precisionRow;
+        MpFloat preciseCenterX;
+        MpFloat preciseCenterY;
+
+        QAtomicInteger<qint64> iteratedPixels;
+        QAtomicInteger<qint64> iterations;
+        QAtomicInteger<qint64> bulbPixels;
+        QAtomicInteger<qint64> periodicPixels;
+        QAtomicInteger<qint64> filledPixels;
+        QAtomicInteger<qint64> cacheHits;
+        QAtomicInteger<qint64> cacheMisses;
+        QAtomicInteger<qint64> glitchedPixels;
+    };
+
+    /*!
+     * \brief 一次整幅上色, 所有线程按行块领取
+     */
+    struct ColorPass
+    {
+        uchar *bits;
+        int bytesPerLine;
+        ColorMap map;
+        QAtomicInt nextRow;     //--下一个待领取的行块的首行
+        QAtomicInt allBlack;    //--是否全黑(任一像素逃逸则清零)
+    };
+
+    /*!
+     * \brief 一个分块的统计, 分块结束时累加到 TilePass
+     */
+    struct TileCounters
+    {
+        qint64 iteratedPixels;
+        qint64 iterations;
+        qint64 bulbPixels;
+        qint64 periodicPixels;
+        qint64 filledPixels;
+        qint64 cacheHits;
+        qint64 cacheMisses;
+        qint64 glitchedPixels;
+    };
+
+    /*!
+     * \brief 迭代状态缓冲区, 按行保存每个像素的 z / 迭代次数 / 状态(PixelStatus)
+     *        同一渲染请求的各轮之间保留, 下一轮只继续上一轮未逃逸的像素;
+     *        新的渲染请求(restart)开始时, 纯平移则移动后沿用, 否则作废;
+     *        深度缩放时 zr / zi 保存相对参考点的 δz; double-double / 定点数的低位部分在 zrLo / ziLo
+     */
+    struct IterationBuffer
+    {
+        int width = 0;
+        int height = 0;
+
+        ///--缓冲区对应的渲染参数, 像素 (0, 0) 处的 C, 多精度(深度缩放时 double 分辨不出平移量)
+        MpFloat originX;
+        MpFloat originY;
+        double scaleFactor = 0;
+        int options = 0;
+        int precision = PrecisionDouble;
+        Fractal fractal;
+
+        QVector<double> zr;
+        QVector<double> zi;
+        QVector<double> zrLo;
+        QVector<double> ziLo;
+        QVector<int> iterations;
+        QVector<uchar> status;
+
+        void reset(int width, int height);
+        bool translate(const MpFloat &originX, const MpFloat &originY, double scaleFactor,
+                       int width, int height, int options, int precision, const Fractal &fractal);
+    };
+
+    friend class TileRunnable;
+    friend class ColorRunnable;
+    friend class SpeculationRunnable;
+
+    /*!
+     * \brief 帧预算模式下本片的截止时间已到
+     */
+    bool sliceExpired() const { return sliceDeadlineNs > 0 && sliceTimer.nsecsElapsed() > sliceDeadlineNs; }
+
+    /*!
+     * \brief 有新的渲染请求、要终止或本片到时: 工作线程在分块、行和迭代分段之间检查, 不必等一整行算完
+     */
+    bool interrupted() const
+    {
+        return restart.loadAcquire() || abort.loadAcquire() || preempted.loadAcquire() || sliceExpired();
+    }
+
+    void renderTiles(TilePass *tilePass);
+    void renderTile(TilePass *tilePass, int tile);
+    void iterateRow(TilePass *tilePass, TileCounters *counters, int row, int left, int right, int step = 1);
+    void traceRect(TilePass *tilePass, TileCounters *counters, int left, int top, int right, int bottom);
+    ColorMap colorSettings();
+    bool colorImage(uchar *bits, int bytesPerLine);
+    void colorRows(ColorPass *colorPass);
+    void colorPreviewTile(TilePass *tilePass, int left, int top, int right, int bottom);
+    bool tileNeedsWork(TilePass *tilePass, int left, int top, int right, int bottom) const;
+    bool loadCachedTile(const TileKey &key, int tileLeft, int tileTop,
+                        int left, int top, int right, int bottom);
+    void storeCachedTile(const TileKey &key, int left, int top);
+    bool extendOrbit(ReferenceOrbit *orbit, int maxIterations);
+    int resolveGlitches(TilePass *tilePass);
+    int mirrorRows(TilePass *tilePass);
+    bool speculate(const SpeculativeView &view, int options, int maxIterations);
+    void preemptSpeculation();
+    IterationSchedule::PassSummary summarizePass(const IterationSchedule &schedule, const QRect &rect) const;
+    int dwell(int index) const;
+
+    /// \brief 分块边长(像素), 集合边界附近的分块计算量远大于外部, 分块越小负载越均衡
+    enum { TileSize = 64 };
+
+    /// \brief Mariani-Silver 细分到边长不超过此值时逐行计算
+    enum { MinTraceSize = 6 };
+
+    /// \brief 每轮最多使用的参考点数(含中心), 用完仍失真的像素本轮按黑色
+    enum { MaxReferences = 16 };
+
+    /// \brief 多精度参考轨道每次延长的迭代次数, 段间检查重启/终止
+    enum { OrbitChunk = 4096 };
+
+    /// \brief 一行中一组像素每迭代约这么多次(像素数 x 迭代次数)检查一次重启/终止,
+    ///        至少 MinCancelSlice 次迭代一段, 段内仍能检测周期
+    enum { CancelCheckIterations = 1 << 18, MinCancelSlice = 1024 };
+
+    /// \brief 最粗一层预览的采样间隔, 之后每层减半直到全分辨率
+    enum { PreviewStep = 8 };
+
+    /// \brief 推测: 每个视图放入缓存的分块不超过缓存容量的 1/SpeculationShare, 不挤掉太多真实视图的分块
+    enum { SpeculationShare = 4 };
+
+    /// \brief 上色时每个线程每次领取的行数
+    enum { ColorRows = 16 };
+
+    ///--Mandelbrot 逃逸时间内核和上色函数, 构造时按 CPU 支持的指令集选择
+    KernelIsa kernelIsa;
+    EscapeTimeRowFunction escapeTimeRow;
+    ColorRowFunction colorRow;
+
+    IterationBuffer state;
+
+    ///--深度缩放: 当前请求中心的参考轨道, 各轮逐步延长; 中心不变的下一请求(缩放序列)接着使用
+    ReferenceOrbit reference;
+
+    TileCache tileCache;
+
+    ///--渲染结果: 每轮写入 back 帧, 完成后发布
+    FrameRing frames;
+
+    ///--渲染工作线程池, 线程数 = CPU 核数 - 1(渲染线程自身也领取分块)
+    QThreadPool pool;
+    int workerCount;
+    int threadCount;
+
+    ///--帧预算: 每片的毫秒数(0 为关闭)和线程数; 本片计时与迭代的截止时间(渲染线程在启动工作线程前设置)
+    int budgetMs;
+    int budgetThreads;
+    QElapsedTimer sliceTimer;
+    qint64 sliceDeadlineNs;
+
+    ///--本次请求中工作线程(含渲染线程)在分块和上色中的时间, 估算 CPU 占用
+    QAtomicInteger<qint64> busyNs;
+
+    ///--空闲推测: 待算的视图, 是否正在推测(mutex 保护); 推测用的迭代状态缓冲区, 与 state 交换使用;
+    ///--推测专用线程池, 线程一直是最低优先级, 线程数 = workerCount(渲染线程只等待)
+    QVector<SpeculativeView> speculativeViews;
+    bool speculating;
+    SpeculationCounters speculation;
+    IterationBuffer speculativeState;
+    QThreadPool speculationPool;
+
+    ///--最近一次渲染完成时的迭代次数(mutex 保护), iterationMap() 返回
+    QVector<int> finishedMap;
 
     QMutex mutex;
     QWaitCondition condition;
-    double centerX;
-    double centerY;
+    MpFloat centerX;
+    MpFloat centerY;
     double scaleFactor;
     QSize resultSize;
-    bool restart;
-    bool abort;
+    int options;
+    int maxIterations;
+    Fractal fractal;
+    Statistics stats;
+
+    ///--上色设置; recolor: 设置改变后还没有按新设置上色
+    Palette palette;
+    int colorOptions;
+    int colorOffset;
+    bool recolor;
+
+    ///--渲染请求序号, 随帧发布, 读端据此判断帧是否已反映某次请求
+    qint64 request;
+
+    ///--render() / 析构时在 mutex 内置位, 所有工作线程不加锁读取
+    QAtomicInt restart;
+    QAtomicInt abort;
+
+    ///--推测时有新的设置或推测视图: 在 mutex 内置位, 推测的工作线程在分段之间停止
+    QAtomicInt preempted;
 
     /*!
      * @brief
@@ -104,10 +502,9 @@ private:
      *
      * //--QImage::Format_RGB32 存储使用32位RGB格式的图像(0xffrrggbb)透明度a最大
      */
-    enum { ColormapSize = 512 };//2^9
-
-    ///--颜色空间
-    uint colormap[ColormapSize];
+    ///--颜色空间: 当前调色板 colormapPalette 的 PaletteSize 个颜色, 只由渲染线程在上色之间重新生成
+    uint colormap[PaletteSize];
+    Palette colormapPalette;
 };
 //! [0]
 
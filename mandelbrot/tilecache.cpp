@@ -0,0 +1,266 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   分块缓存(LRU)
+*
+*           QHash 查找, 双向链表维护使用顺序, 一把互斥锁保护(每个分块只访问一次, 竞争很小);
+*           磁盘读写不持这把锁, 不让其它渲染线程等待磁盘.
+*           磁盘文件: 每个分块一个文件, 文件头 + 原始数组.
+**********************************************************/
+
+#include "tilecache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <cmath>
+
+/// \brief 磁盘文件头
+static const quint32 SpillMagic = 0x4d54494c;   //--"MTIL"
+static const quint32 SpillVersion = 2;         //--2: 每轮只迭代到 maxIterations - 1 次
+
+/// \brief 磁盘文件的字节数
+static const qint64 SpillFileBytes = 3 * sizeof(quint32) + TileCache::tileBytes();
+
+TileCache::TileCache(qint64 capacityBytes, const QString &spillDirectory, qint64 spillCapacityBytes)
+    : head(nullptr), tail(nullptr), capacity(capacityBytes), spillDirectory(spillDirectory),
+      maxSpillFiles(spillCapacityBytes / SpillFileBytes)
+{
+    stats = Counters();
+
+    if (spillDirectory.isEmpty())
+        return;
+
+    //--已有的分块文件从旧到新排队, 超出上限的先删掉
+    QDir().mkpath(spillDirectory);
+    const QFileInfoList files = QDir(spillDirectory).entryInfoList(QStringList() << "*.tile", QDir::Files,
+                                                                   QDir::Time | QDir::Reversed);
+    for (const QFileInfo &file : files)
+        addSpillFile(file.filePath());
+}
+
+/*!
+ * \brief 退出时不写磁盘: 内存中的分块可能有几百 MB, 只有淘汰的分块才落盘
+ */
+TileCache::~TileCache()
+{
+    while (head) {
+        Node *node = head;
+        head = node->next;
+        delete node;
+    }
+}
+
+/*!
+ * \brief 缩放量化: round(log2(scaleFactor) * ScaleSteps)
+ */
+qint64 TileCache::scaleKey(double scaleFactor)
+{
+    return qint64(std::floor(std::log2(scaleFactor) * ScaleSteps + 0.5));
+}
+
+/*!
+ * \brief 量化级别对应的缩放, 同一级别总是得到同一个 double
+ */
+double TileCache::scaleForKey(qint64 key)
+{
+    return std::exp2(double(key) / ScaleSteps);
+}
+
+qint64 TileCache::tileBytes()
+{
+    return qint64(TileSize) * TileSize * (2 * sizeof(double) + sizeof(int) + sizeof(uchar));
+}
+
+bool TileCache::lookup(const TileKey &key, TileData *data)
+{
+    {
+        QMutexLocker locker(&mutex);
+
+        Node *node = nodes.value(key, nullptr);
+        if (node) {
+            unlink(node);
+            pushFront(node);
+            *data = node->data;
+            ++stats.hits;
+            return true;
+        }
+    }
+
+    //--内存未命中, 再找磁盘(不持锁); 读到的分块放回内存
+    bool found = !spillDirectory.isEmpty() && readSpill(key, data);
+    if (found)
+        store(key, *data, true);
+
+    QMutexLocker locker(&mutex);
+    if (found)
+        ++stats.diskHits;
+    else
+        ++stats.misses;
+    return found;
+}
+
+void TileCache::insert(const TileKey &key, const TileData &data)
+{
+    store(key, data, false);
+}
+
+/*!
+ * \brief 放入内存, 超出上限时淘汰最久未用的分块; 淘汰的分块在锁外写入磁盘
+ */
+void TileCache::store(const TileKey &key, const TileData &data, bool onDisk)
+{
+    QVector<Node *> evicted;
+    {
+        QMutexLocker locker(&mutex);
+
+        Node *node = nodes.value(key, nullptr);
+        if (node) {
+            //--其它线程刚算完同一分块, 内容相同, 只更新使用顺序
+            unlink(node);
+            pushFront(node);
+            node->onDisk = node->onDisk || onDisk;
+            return;
+        }
+
+        node = new Node;
+        node->key = key;
+        node->data = data;
+        node->onDisk = onDisk;
+        nodes.insert(key, node);
+        pushFront(node);
+
+        ++stats.tiles;
+        stats.bytes += tileBytes();
+
+        while (stats.bytes > capacity && tail)
+            evicted.append(evict());
+    }
+
+    for (Node *node : evicted) {
+        if (!spillDirectory.isEmpty() && !node->onDisk)
+            writeSpill(node->key, node->data);
+        delete node;
+    }
+}
+
+TileCache::Counters TileCache::counters()
+{
+    QMutexLocker locker(&mutex);
+    return stats;
+}
+
+void TileCache::unlink(Node *node)
+{
+    if (node->prev)
+        node->prev->next = node->next;
+    else
+        head = node->next;
+
+    if (node->next)
+        node->next->prev = node->prev;
+    else
+        tail = node->prev;
+}
+
+void TileCache::pushFront(Node *node)
+{
+    node->prev = nullptr;
+    node->next = head;
+    if (head)
+        head->prev = node;
+    head = node;
+    if (!tail)
+        tail = node;
+}
+
+/*!
+ * \brief 从内存中摘下最久未用的分块, 由调用者在锁外写盘并释放
+ */
+TileCache::Node *TileCache::evict()
+{
+    Node *node = tail;
+    unlink(node);
+    nodes.remove(node->key);
+
+    --stats.tiles;
+    stats.bytes -= tileBytes();
+    ++stats.evictions;
+    return node;
+}
+
+QString TileCache::spillPath(const TileKey &key) const
+{
+    return QDir(spillDirectory).filePath(QString("%1_%2_%3_%4_%5.tile")
+                                         .arg(key.scale).arg(key.x).arg(key.y).arg(key.maxIterations)
+                                         .arg(key.options));
+}
+
+bool TileCache::readSpill(const TileKey &key, TileData *data)
+{
+    QFile file(spillPath(key));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    quint32 header[3];
+    if (file.read(reinterpret_cast<char *>(header), sizeof(header)) != sizeof(header)
+            || header[0] != SpillMagic || header[1] != SpillVersion || header[2] != TileSize)
+        return false;
+
+    const int size = TileSize * TileSize;
+    data->zr.resize(size);
+    data->zi.resize(size);
+    data->iterations.resize(size);
+    data->status.resize(size);
+
+    return file.read(reinterpret_cast<char *>(data->zr.data()), size * sizeof(double)) == qint64(size * sizeof(double))
+            && file.read(reinterpret_cast<char *>(data->zi.data()), size * sizeof(double)) == qint64(size * sizeof(double))
+            && file.read(reinterpret_cast<char *>(data->iterations.data()), size * sizeof(int)) == qint64(size * sizeof(int))
+            && file.read(reinterpret_cast<char *>(data->status.data()), size) == size;
+}
+
+/*!
+ * \brief 写入磁盘: 先写临时文件, 完整写完才改名替换, 崩溃时不会留下截断的文件;
+ *        已有的文件(版本不同或被截断, 所以这个分块才需要重新计算)直接覆盖
+ */
+void TileCache::writeSpill(const TileKey &key, const TileData &data)
+{
+    QString path = spillPath(key);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    const int size = TileSize * TileSize;
+    const quint32 header[3] = { SpillMagic, SpillVersion, TileSize };
+    file.write(reinterpret_cast<const char *>(header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(data.zr.constData()), size * sizeof(double));
+    file.write(reinterpret_cast<const char *>(data.zi.constData()), size * sizeof(double));
+    file.write(reinterpret_cast<const char *>(data.iterations.constData()), size * sizeof(int));
+    file.write(reinterpret_cast<const char *>(data.status.constData()), size);
+    if (file.commit())
+        addSpillFile(path);
+}
+
+/*!
+ * \brief 记下新写入的分块文件, 文件数超出 maxSpillFiles 时删除最早写入的
+ */
+void TileCache::addSpillFile(const QString &path)
+{
+    QStringList removed;
+    spillMutex.lock();
+    if (!spillNames.contains(path)) {
+        spillNames.insert(path);
+        spillFiles.enqueue(path);
+    }
+    while (spillFiles.size() > maxSpillFiles) {
+        QString oldest = spillFiles.dequeue();
+        spillNames.remove(oldest);
+        removed << oldest;
+    }
+    spillMutex.unlock();
+
+    for (const QString &name : removed)
+        QFile::remove(name);
+}
@@ -0,0 +1,151 @@
+/**********************************************************
+*   Author  :   wmx
+*   Date    :   2019/
+*   comment :   分块缓存(LRU), 缓存世界坐标对齐分块的迭代状态
+*
+*           键 = (量化后的缩放, 世界分块坐标, 本轮最大迭代次数, 影响结果的选项).
+*           缩放量化到 1/ScaleSteps 个 2 的幂, 像素 C 只由世界像素坐标决定,
+*           不同视图(平移, 放大后再缩小)算到同一分块时结果逐位相同, 可以直接复用;
+*           Mariani-Silver 填充的像素是近似值, 内部点捷径改变未逃逸像素的状态, 选项不同的分块不混用.
+*           内存按字节数限制, 超出时淘汰最久未用的分块;
+*           指定磁盘目录时, 淘汰的分块写入磁盘, 未命中时从磁盘读取, 可跨进程复用;
+*           读写文件都在锁外, 写入先写临时文件再改名(QSaveFile), 目录中的分块文件总大小有上限,
+*           超出时删除最早写入的文件.
+**********************************************************/
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief 分块缓存的键
+ */
+struct TileKey
+{
+    /// \brief options 中 EscapeTimeOption 之外的位: 用 Mariani-Silver 细分计算(可能含填充的像素)
+    enum { MarianiSilver = 0x100 };
+
+    qint64 scale;           //--TileCache::scaleKey()
+    qint64 x;               //--世界分块坐标 = floor(世界像素坐标 / TileSize)
+    qint64 y;
+    int maxIterations;
+    int options;            //--EscapeTimeOption | MarianiSilver
+
+    bool operator==(const TileKey &other) const
+    {
+        return scale == other.scale && x == other.x && y == other.y
+                && maxIterations == other.maxIterations && options == other.options;
+    }
+};
+
+inline uint qHash(const TileKey &key, uint seed = 0)
+{
+    return qHash(key.scale, seed) ^ qHash(key.x, seed + 1) ^ (qHash(key.y, seed + 2) << 1)
+            ^ qHash(key.maxIterations, seed + 3) ^ (qHash(key.options, seed + 4) << 2);
+}
+
+/*!
+ * \brief 一个完整分块(TileSize x TileSize)的迭代状态, 按行存储
+ */
+struct TileData
+{
+    QVector<double> zr;
+    QVector<double> zi;
+    QVector<int> iterations;
+    QVector<uchar> status;
+};
+
+class TileCache
+{
+public:
+    /// \brief 分块边长(像素), 与 RenderThread::TileSize 相同
+    enum { TileSize = 64 };
+
+    /// \brief 每个 2 的幂分成多少级缩放, 相邻两级相差约 0.07%
+    enum { ScaleSteps = 1024 };
+
+    /*!
+     * \brief 命中统计
+     */
+    struct Counters
+    {
+        qint64 hits;            //--内存命中
+        qint64 diskHits;        //--磁盘命中
+        qint64 misses;
+        qint64 evictions;
+        int tiles;              //--内存中的分块数
+        qint64 bytes;           //--内存中的字节数
+    };
+
+    /*!
+     * \param capacityBytes 内存上限
+     * \param spillDirectory 磁盘目录, 为空则不写磁盘
+     * \param spillCapacityBytes 磁盘目录中分块文件的总大小上限
+     */
+    TileCache(qint64 capacityBytes, const QString &spillDirectory = QString(),
+              qint64 spillCapacityBytes = qint64(1024) * 1024 * 1024);
+    ~TileCache();
+
+    /*!
+     * \brief 查找分块, 命中时复制到 data 并标记为最近使用
+     */
+    bool lookup(const TileKey &key, TileData *data);
+
+    void insert(const TileKey &key, const TileData &data);
+
+    Counters counters();
+
+    ///--内存上限(字节)
+    qint64 capacityBytes() const { return capacity; }
+
+    static qint64 scaleKey(double scaleFactor);
+    static double scaleForKey(qint64 key);
+
+    ///--每个分块占用的字节数
+    static qint64 tileBytes();
+
+private:
+    /*!
+     * \brief LRU 双向链表节点, head 最近使用, tail 最久未用
+     */
+    struct Node
+    {
+        TileKey key;
+        TileData data;
+        bool onDisk;            //--磁盘上已有完整的文件(从磁盘读出或已写入), 淘汰时不再写
+        Node *prev;
+        Node *next;
+    };
+
+    void store(const TileKey &key, const TileData &data, bool onDisk);
+    void unlink(Node *node);
+    void pushFront(Node *node);
+    Node *evict();
+
+    QString spillPath(const TileKey &key) const;
+    bool readSpill(const TileKey &key, TileData *data);
+    void writeSpill(const TileKey &key, const TileData &data);
+    void addSpillFile(const QString &path);
+
+    QMutex mutex;
+    QHash<TileKey, Node *> nodes;
+    Node *head;
+    Node *tail;
+    qint64 capacity;
+    QString spillDirectory;
+    Counters stats;
+
+    ///--磁盘目录中的分块文件, 按写入先后排列(spillMutex 保护); 最多 maxSpillFiles 个
+    QMutex spillMutex;
+    QQueue<QString> spillFiles;
+    QSet<QString> spillNames;
+    qint64 maxSpillFiles;
+};
+
+#endif // TILECACHE_H
@@ -4,10 +4,12 @@
 
 // Name: spinlockvsmutex1.cc
 // Source: http://www.alexonlinux.com/pthread-mutex-vs-pthread-spinlock
-// Compiler(spin lock version): g++ -o spin_version -DUSE_SPINLOCK spinlockvsmutex1.cc -lpthread
-// Compiler(mutex version): g++ -o mutex_version spinlockvsmutex1.cc -lpthread
+// Compiler: g++ -O2 -std=c++17 -I../common -o spinlockvsmutex1 main.cc -lpthread
+// Run(all policies):      ./spinlockvsmutex1
+// Run(selected policies): ./spinlockvsmutex1 pthread_spin pthread_mutex
 
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <errno.h>
@@ -15,47 +17,43 @@
 #include <list>
 #include <pthread.h>
 
+#include "lockpolicy.h"
+
+#ifndef LOOPS
 #define LOOPS 50000000
+#endif
+
+//--预热轮次的列表长度, 每种锁策略都先跑一轮相同的预热
+#ifndef WARMUP_LOOPS
+#define WARMUP_LOOPS (LOOPS / 10)
+#endif
 
 using namespace std;
 
 list<int> the_list;
 
 
-//-- spinlock 或者 mutex
-#ifdef USE_SPINLOCK
-pthread_spinlock_t spinlock;
-#else
-pthread_mutex_t mutex;
-#endif
-
-
 //Get the thread id
 pid_t gettid() { return syscall( __NR_gettid ); }
 
+/*!
+ * \brief 消费者线程, 以锁策略为模板参数, 每个实例中 lock()/unlock() 完全内联
+ * \param ptr 锁策略对象
+ */
+template <class Lock>
 void *consumer(void *ptr)
 {
+    Lock *lock = static_cast<Lock *>(ptr);
     int i;
 
-    //--打印线程ＩＤ
-    printf("Consumer Thread ID %lu\n", (unsigned long)gettid());
-
     while (1)
     {
-#ifdef USE_SPINLOCK
-        pthread_spin_lock(&spinlock);
-#else
-        pthread_mutex_lock(&mutex);
-#endif
+        lock->lock();
 
         //--列表为空，结束
         if (the_list.empty())
         {
-#ifdef USE_SPINLOCK
-            pthread_spin_unlock(&spinlock);
-#else
-            pthread_mutex_unlock(&mutex);
-#endif
+            lock->unlock();
             break;
         }
 
@@ -65,31 +63,26 @@ void *consumer(void *ptr)
         i = the_list.front();
         the_list.pop_front();
 
-#ifdef USE_SPINLOCK
-        pthread_spin_unlock(&spinlock);
-#else
-        pthread_mutex_unlock(&mutex);
-#endif
+        lock->unlock();
     }
 
+    (void)i;
     return NULL;
 }
 
-int main()
+/*!
+ * \brief 生产者填充列表, 两个消费者线程取空列表, 返回耗时(微秒)
+ */
+template <class Lock>
+long consume_all(Lock *lock, int loops)
 {
     int i;
     pthread_t thr1, thr2;
     struct timeval tv1, tv2;
 
-#ifdef USE_SPINLOCK
-    pthread_spin_init(&spinlock, 0);
-#else
-    pthread_mutex_init(&mutex, NULL);
-#endif
-
     // Creating the list content...
     //--生产者,创建列表内容
-    for (i = 0; i < LOOPS; i++)
+    for (i = 0; i < loops; i++)
         the_list.push_back(i);
 
     // Measuring time before starting the threads...
@@ -97,8 +90,8 @@ int main()
     gettimeofday(&tv1, NULL);
 
     //--创建两个消费者线程
-    pthread_create(&thr1, NULL, consumer, NULL);
-    pthread_create(&thr2, NULL, consumer, NULL);
+    pthread_create(&thr1, NULL, consumer<Lock>, lock);
+    pthread_create(&thr2, NULL, consumer<Lock>, lock);
 
     //--主线程等待两个消费者线程结束
     pthread_join(thr1, NULL);
@@ -108,21 +101,62 @@ int main()
     //--线程结束时间
     gettimeofday(&tv2, NULL);
 
-    if (tv1.tv_usec > tv2.tv_usec)
-    {
-        tv2.tv_sec--;
-        tv2.tv_usec += 1000000;
+    return (tv2.tv_sec - tv1.tv_sec) * 1000000L + (tv2.tv_usec - tv1.tv_usec);
+}
+
+/*!
+ * \brief 命令行未指定策略时运行全部, 否则只运行指定名字的策略
+ */
+static bool selected(const char *name, int argc, char *argv[])
+{
+    if (argc < 2)
+        return true;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return true;
     }
+    return false;
+}
+
+/*!
+ * \brief 运行一种锁策略: 预热一轮, 再计时一轮
+ */
+template <class Lock>
+void run_policy(int argc, char *argv[])
+{
+    Lock lock;
+    long usec;
+
+    if (!selected(Lock::name(), argc, argv))
+        return;
+
+    lock.init();
+
+    //--预热: 线程创建、内存分配器、缓存, 各策略条件一致
+    consume_all(&lock, WARMUP_LOOPS);
+
+    usec = consume_all(&lock, LOOPS);
 
     //--打印耗时
-    printf("Result - %ld.%ld\n", tv2.tv_sec - tv1.tv_sec,
-        tv2.tv_usec - tv1.tv_usec);
+    printf("%-16s Result - %ld.%06ld\n", Lock::name(), usec / 1000000, usec % 1000000);
 
-#ifdef USE_SPINLOCK
-    pthread_spin_destroy(&spinlock);
-#else
-    pthread_mutex_destroy(&mutex);
-#endif
+    lock.destroy();
+}
+
+int main(int argc, char *argv[])
+{
+    //--打印线程ＩＤ
+    printf("Main Thread ID %lu, LOOPS %d\n", (unsigned long)gettid(), LOOPS);
+
+    //--同一次运行中依次比较各种锁
+    run_policy<PthreadSpinLock>(argc, argv);
+    run_policy<PthreadMutex>(argc, argv);
+    run_policy<PthreadAdaptiveMutex>(argc, argv);
+    run_policy<TicketLock>(argc, argv);
+    run_policy<McsLock>(argc, argv);
+    run_policy<SpinYieldLock>(argc, argv);
+    run_policy<SpinParkLock>(argc, argv);
 
     return 0;
 }
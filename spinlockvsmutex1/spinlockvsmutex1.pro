@@ -2,21 +2,22 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += c++17
 
 SOURCES += \
         main.cc
 
-unix:!macx: LIBS += -lpthread
+HEADERS += \
+        ../common/lockpolicy.h
 
+INCLUDEPATH += ../common
 
+unix:!macx: LIBS += -lpthread
 
-#message(COMPILE)
-#system( g++ -o spin_version -DUSE_SPINLOCK $$SOURCES -lpthread)
-#system( g++ -o mutex_version $$SOURCES -lpthread)
 
-#message(RUN mutex_version)
-#system(time ./mutex_version)
 
-#message(RUN spin_version)
-#system(time ./spin_version)
+#message(COMPILE)
+#system( g++ -O2 -std=c++17 -I../common -o spinlockvsmutex1 $$SOURCES -lpthread)
 
+#message(RUN all lock policies)
+#system(time ./spinlockvsmutex1)
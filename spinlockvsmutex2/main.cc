@@ -0,0 +1,806 @@
+
+//-- 多核多线程自旋锁spinlock 与互斥量mutex性能分析
+//-- https://blog.csdn.net/WMX843230304WMX/article/details/100052812
+
+//Name: svm2.c
+//Source: http://www.solarisinternals.com/wiki/index.php/DTrace_Topics_Locks
+//Compile: g++ -O2 -std=c++17 -I../common -o spinlockvsmutex2 main.cc -lpthread
+//Run(all policies, all modes): ./spinlockvsmutex2
+//Run(selected):                ./spinlockvsmutex2 pthread_spin pthread_mutex sharded atomic
+//Run(crossover sweep, CSV):    ./spinlockvsmutex2 crossover > crossover.csv
+//Run(oversubscription):        ./spinlockvsmutex2 oversub [policy...]
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#include <atomic>
+
+#include "lockpolicy.h"
+
+//--线程数量
+#define        THREAD_NUM     2
+
+//--线程数量上限(crossover 扫描时线程数 = 核数 x 超额倍数)
+#define        MAX_THREADS    1024
+
+//--每个线程请求锁的次数
+#ifndef LOCK_LOOPS
+#define        LOCK_LOOPS     10000
+#endif
+
+//--每获取一次锁的累加次数
+#define        INNER_LOOPS    100000
+
+//--预热时每个线程请求锁的次数, 每种锁策略相同
+#define        WARMUP_LOOPS   (LOCK_LOOPS / 100)
+
+//--累加到此值的线程获胜
+#define        WIN_COUNT      123456789ULL
+
+//--最多记录的结果条数
+#define        MAX_RESULTS    16
+
+//--等待/持锁时间直方图桶数, 第 b 桶为 [2^(b-1), 2^b) 纳秒, 第 0 桶为 0 纳秒
+#define        HIST_BUCKETS   40
+
+//--oversub 模式: 所有线程合计请求锁的次数, 与默认 2 线程时相同
+#define        OVERSUB_LOCKS  (THREAD_NUM * LOCK_LOOPS)
+
+//--crossover 扫描: 每次运行的累加总次数, 不随临界区长度变化
+#define        CROSSOVER_TOTAL      (1 << 24)
+
+//--crossover 扫描: 临界区长度上限(内层循环次数)
+#define        CROSSOVER_MAX_INNER  (1 << 17)
+
+//--crossover 扫描: 每个配置重复次数, 取最短耗时
+#define        CROSSOVER_REPEAT     3
+
+//--crossover 扫描: 找到区间后二分细化的次数
+#define        CROSSOVER_BISECT     4
+
+pthread_t g_thread[MAX_THREADS];
+
+
+__uint64_t g_count;
+
+//--atomic 模式: 按块原子累加
+std::atomic<__uint64_t> g_atomic_count;
+
+/*!
+ * \brief sharded 模式: 每个线程独占一个缓存行的计数器, 结束后合并
+ *        count 为 volatile, 每次累加都真正读写内存, 与 locked 模式的工作量相同
+ */
+struct shard
+{
+    volatile __uint64_t count;
+    pid_t tid;
+    int finish_order;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+shard g_shard[MAX_THREADS];
+
+//--sharded 模式: 线程完成顺序
+std::atomic<int> g_finish_ticket;
+
+/*!
+ * \brief locked 模式: 每线程锁公平性统计
+ *        等待时间 = 调用 lock() 到获得锁, 持锁时间 = 获得锁到 unlock()
+ *        连续重入 = 释放锁后下一次又是自己获得锁(中间没有其他线程持锁)
+ */
+struct lock_stats
+{
+    __uint64_t wait_hist[HIST_BUCKETS];
+    __uint64_t hold_hist[HIST_BUCKETS];
+    __uint64_t wait_total_ns;
+    __uint64_t wait_max_ns;
+    __uint64_t hold_total_ns;
+    __uint64_t acquires;
+    __uint64_t reacquires;
+    __uint64_t streak;
+    __uint64_t max_streak;
+    pid_t tid;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+//--locked 模式: 最近一次持锁的线程序号, 只在锁内读写
+int g_last_owner;
+
+//--是否打印获胜线程; oversub 模式累加总数超过 WIN_COUNT, 不打印, 以免插在结果表的行之间
+int g_report_win = 1;
+
+/*!
+ * \brief 工作线程参数
+ */
+struct amuck_arg
+{
+    void *lock;
+    int index;
+    int loops;
+    int inner;
+    int verbose;
+    lock_stats *stats;
+};
+
+/*!
+ * \brief 一次计时结果
+ */
+struct result
+{
+    const char *mode;
+    const char *policy;
+    long usec;
+    __uint64_t count;
+    int has_stats;
+    lock_stats stats[THREAD_NUM];
+};
+
+result g_result[MAX_RESULTS];
+int g_result_num;
+
+pid_t gettid()
+{
+    return syscall(SYS_gettid);
+}
+
+static inline __uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*!
+ * \brief 纳秒数对应的 log2 直方图桶
+ */
+static inline int hist_bucket(__uint64_t ns)
+{
+    int b = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+    return b < HIST_BUCKETS ? b : HIST_BUCKETS - 1;
+}
+
+/*!
+ * \brief 获得锁后记录等待时间和连续重入
+ */
+static inline void stats_acquired(lock_stats *st, int index, __uint64_t wait_ns)
+{
+    st->wait_hist[hist_bucket(wait_ns)]++;
+    st->wait_total_ns += wait_ns;
+    if (wait_ns > st->wait_max_ns)
+        st->wait_max_ns = wait_ns;
+
+    if (st->acquires > 0 && g_last_owner == index) {
+        st->reacquires++;
+        st->streak++;
+    } else {
+        st->streak = 1;
+    }
+    if (st->streak > st->max_streak)
+        st->max_streak = st->streak;
+
+    g_last_owner = index;
+    st->acquires++;
+}
+
+/*!
+ * \brief 释放锁前记录持锁时间
+ */
+static inline void stats_released(lock_stats *st, __uint64_t hold_ns)
+{
+    st->hold_hist[hist_bucket(hold_ns)]++;
+    st->hold_total_ns += hold_ns;
+}
+
+/*!
+ * \brief locked 模式(原始版本): 工作线程, 以锁策略为模板参数, 每个实例中 lock()/unlock() 完全内联
+ */
+template <class Lock>
+void *run_amuck(void *arg)
+{
+       amuck_arg *a = static_cast<amuck_arg *>(arg);
+       Lock *lock = static_cast<Lock *>(a->lock);
+       lock_stats *st = a->stats;
+       __uint64_t t0 = 0, t1 = 0;
+       int i, j;
+
+       if (st != NULL)
+               st->tid = gettid();
+
+       //--打印线程ＩＤ
+       if (a->verbose)
+               printf("Thread %lu started.\n", (unsigned long)gettid());
+
+       //--10000次请求锁
+       for (i = 0; i < a->loops; i++) {
+               if (st != NULL)
+                       t0 = now_ns();
+
+               lock->lock();
+
+               if (st != NULL) {
+                       t1 = now_ns();
+                       stats_acquired(st, a->index, t1 - t0);
+               }
+
+               //--每获取一次锁，执行 100000次 累加 操作
+               //--耗时比较长
+               for (j = 0; j < a->inner; j++) {
+
+                    //--打印优先完成的线程ＩＤ
+                   if (g_count++ == WIN_COUNT && g_report_win){
+                           printf("Thread %lu wins!\n", (unsigned long)gettid());
+                   }
+               }
+
+               if (st != NULL)
+                       stats_released(st, now_ns() - t1);
+
+               lock->unlock();
+       }
+
+       //--打印线程ＩＤ
+       if (a->verbose)
+               printf("Thread %lu finished!\n", (unsigned long)gettid());
+
+       return (NULL);
+}
+
+/*!
+ * \brief atomic 模式: 每块 INNER_LOOPS 次累加合并为一次 fetch_add,
+ *        fetch_add 返回值即该块在全局序列中的起点, 获胜判断与 locked 模式一致
+ */
+void *run_atomic(void *arg)
+{
+       amuck_arg *a = static_cast<amuck_arg *>(arg);
+       int i;
+
+       if (a->verbose)
+               printf("Thread %lu started.\n", (unsigned long)gettid());
+
+       for (i = 0; i < a->loops; i++) {
+               __uint64_t first = g_atomic_count.fetch_add(a->inner, std::memory_order_relaxed);
+
+               //--WIN_COUNT 落在本块 [first, first + inner) 内
+               if (first <= WIN_COUNT && WIN_COUNT < first + a->inner && g_report_win)
+                       printf("Thread %lu wins!\n", (unsigned long)gettid());
+       }
+
+       if (a->verbose)
+               printf("Thread %lu finished!\n", (unsigned long)gettid());
+
+       return (NULL);
+}
+
+/*!
+ * \brief sharded 模式: 在自己的缓存行上累加, 不需要锁, 也没有伪共享
+ */
+void *run_sharded(void *arg)
+{
+       amuck_arg *a = static_cast<amuck_arg *>(arg);
+       shard *s = &g_shard[a->index];
+       int i, j;
+
+       s->tid = gettid();
+
+       if (a->verbose)
+               printf("Thread %lu started.\n", (unsigned long)s->tid);
+
+       for (i = 0; i < a->loops; i++) {
+               for (j = 0; j < a->inner; j++)
+                       s->count++;
+       }
+
+       //--记录完成顺序, 合并时按此顺序累加
+       s->finish_order = g_finish_ticket.fetch_add(1, std::memory_order_relaxed);
+
+       if (a->verbose)
+               printf("Thread %lu finished!\n", (unsigned long)s->tid);
+
+       return (NULL);
+}
+
+/*!
+ * \brief sharded 模式合并: 按线程完成顺序累加到 g_count,
+ *        累加越过 WIN_COUNT 的线程获胜
+ */
+void merge_shards(int threads)
+{
+       int order, i;
+
+       g_count = 0;
+       for (order = 0; order < threads; order++) {
+               for (i = 0; i < threads; i++) {
+                       if (g_shard[i].finish_order != order)
+                               continue;
+
+                       if (g_count <= WIN_COUNT && WIN_COUNT < g_count + g_shard[i].count)
+                               printf("Thread %lu wins!\n", (unsigned long)g_shard[i].tid);
+
+                       g_count += g_shard[i].count;
+               }
+       }
+}
+
+/*!
+ * \brief 创建 threads 个工作线程并等待结束, 返回耗时(微秒)
+ * \param inner 每获取一次锁的累加次数
+ * \param cpus  非 NULL 时工作线程只在这些 CPU 上运行
+ * \param stats 非 NULL 时 locked 模式记录每线程公平性统计(threads 个)
+ */
+long run_threads(void *(*func)(void *), void *lock, int threads, int loops, int verbose,
+                 int inner = INNER_LOOPS, const cpu_set_t *cpus = NULL, lock_stats *stats = NULL)
+{
+       int i;
+       struct timeval tv1, tv2;
+       pthread_attr_t attr;
+       static amuck_arg arg[MAX_THREADS];
+
+       pthread_attr_init(&attr);
+       if (cpus != NULL)
+               pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), cpus);
+
+       g_count = 0;
+       g_last_owner = -1;
+       g_atomic_count.store(0);
+       g_finish_ticket.store(0);
+       memset(g_shard, 0, sizeof(g_shard));
+
+       gettimeofday(&tv1, NULL);
+
+       if (stats != NULL)
+               memset(stats, 0, threads * sizeof(lock_stats));
+
+       for (i = 0; i < threads; i++) {
+               arg[i].lock = lock;
+               arg[i].index = i;
+               arg[i].loops = loops;
+               arg[i].inner = inner;
+               arg[i].verbose = verbose;
+               arg[i].stats = stats != NULL ? &stats[i] : NULL;
+               pthread_create(&g_thread[i], &attr, func, &arg[i]);
+       }
+
+
+        /*!
+        * @brief pthread_join
+        *   主线程会一直等待直到等待的线程结束自己才结束
+        *   对线程的资源进行回收
+        */
+       for (i = 0; i < threads; i++)
+               pthread_join(g_thread[i], NULL);
+
+       gettimeofday(&tv2, NULL);
+
+       pthread_attr_destroy(&attr);
+
+       return (tv2.tv_sec - tv1.tv_sec) * 1000000L + (tv2.tv_usec - tv1.tv_usec);
+}
+
+static const char *const g_mode_names[] = { "locked", "sharded", "atomic", NULL };
+static const char *const g_policy_names[] = {
+       "pthread_spin", "pthread_mutex", "adaptive_mutex", "ticket", "mcs",
+       "spin_yield", "spin_park", NULL
+};
+
+/*!
+ * \brief 命令行是否指定了 names 中的任一名字
+ * \param names 同一类的全部名字(策略名或模式名)
+ */
+static bool named(const char *const names[], int argc, char *argv[])
+{
+       int i, k;
+
+       for (i = 1; i < argc; i++) {
+               for (k = 0; names[k] != NULL; k++) {
+                       if (strcmp(argv[i], names[k]) == 0)
+                               return true;
+               }
+       }
+       return false;
+}
+
+/*!
+ * \brief 命令行未指定时运行全部, 否则只运行指定名字的策略/模式
+ * \param names 同一类的全部名字(策略名或模式名)
+ */
+static bool selected(const char *name, const char *const names[], int argc, char *argv[])
+{
+       int i;
+
+       for (i = 1; i < argc; i++) {
+               if (strcmp(argv[i], name) == 0)
+                       return true;
+       }
+       return !named(names, argc, argv);
+}
+
+static void add_result(const char *mode, const char *policy, long usec,
+                       const lock_stats *stats = NULL)
+{
+       result *r;
+
+       if (g_result_num == MAX_RESULTS)
+               return;
+
+       r = &g_result[g_result_num++];
+       r->mode = mode;
+       r->policy = policy;
+       r->usec = usec;
+       r->count = g_count;
+       r->has_stats = stats != NULL;
+       if (stats != NULL)
+               memcpy(r->stats, stats, sizeof(r->stats));
+}
+
+/*!
+ * \brief 打印一个 log2 纳秒直方图的非空桶
+ */
+static void print_hist(const char *title, const __uint64_t hist[HIST_BUCKETS])
+{
+       __uint64_t total = 0, max = 0;
+       int b, k;
+
+       for (b = 0; b < HIST_BUCKETS; b++) {
+               total += hist[b];
+               if (hist[b] > max)
+                       max = hist[b];
+       }
+       if (total == 0)
+               return;
+
+       printf("    %s\n", title);
+       for (b = 0; b < HIST_BUCKETS; b++) {
+               if (hist[b] == 0)
+                       continue;
+
+               __uint64_t lo = b == 0 ? 0 : 1ULL << (b - 1);
+               __uint64_t hi = 1ULL << b;
+               printf("      [%12llu, %12llu) ns %10llu %5.1f%% ", (unsigned long long)lo,
+                      (unsigned long long)hi, (unsigned long long)hist[b], 100.0 * hist[b] / total);
+               for (k = 0; k < (int)(40 * hist[b] / max); k++)
+                       putchar('#');
+               putchar('\n');
+       }
+}
+
+/*!
+ * \brief 打印 locked 模式的锁公平性汇总
+ */
+static void print_fairness(const result *r)
+{
+       int i;
+
+       printf("\n==== fairness %s %s ====\n", r->mode, r->policy);
+       for (i = 0; i < THREAD_NUM; i++) {
+               const lock_stats *st = &r->stats[i];
+               if (st->acquires == 0)
+                       continue;
+
+               printf("  Thread %lu: acquires %llu, consecutive reacquires %llu (%.1f%%), max streak %llu\n",
+                      (unsigned long)st->tid, (unsigned long long)st->acquires,
+                      (unsigned long long)st->reacquires, 100.0 * st->reacquires / st->acquires,
+                      (unsigned long long)st->max_streak);
+               printf("    wait avg %.0f ns, max %llu ns, total %.3f s; hold avg %.0f ns\n",
+                      (double)st->wait_total_ns / st->acquires, (unsigned long long)st->wait_max_ns,
+                      st->wait_total_ns / 1e9, (double)st->hold_total_ns / st->acquires);
+               print_hist("wait time", st->wait_hist);
+               print_hist("hold time", st->hold_hist);
+       }
+}
+
+/*!
+ * \brief locked 模式下运行一种锁策略: 预热一轮, 再计时一轮
+ */
+template <class Lock>
+void run_policy(int argc, char *argv[])
+{
+       Lock lock;
+       long usec;
+       lock_stats stats[THREAD_NUM];
+
+       if (!selected(Lock::name(), g_policy_names, argc, argv))
+               return;
+
+       printf("==== locked %s ====\n", Lock::name());
+
+       lock.init();
+
+       //--预热: 线程创建、缓存, 各策略条件一致
+       run_threads(run_amuck<Lock>, &lock, THREAD_NUM, WARMUP_LOOPS, 0);
+
+       usec = run_threads(run_amuck<Lock>, &lock, THREAD_NUM, LOCK_LOOPS, 1,
+                          INNER_LOOPS, NULL, stats);
+
+       add_result("locked", Lock::name(), usec, stats);
+
+       lock.destroy();
+}
+
+/*!
+ * \brief crossover: 单线程无竞争时每次累加的耗时(纳秒), 用于把内层循环次数换算为持锁时间
+ */
+static double calibrate_ns_per_inner()
+{
+       struct timespec t1, t2;
+       amuck_arg a = { NULL, 0, 1, CROSSOVER_MAX_INNER, 0, NULL };
+       PthreadMutex lock;
+       double best = 0;
+       int r;
+
+       lock.init();
+       a.lock = &lock;
+       for (r = 0; r < CROSSOVER_REPEAT; r++) {
+               g_count = 0;
+               clock_gettime(CLOCK_MONOTONIC, &t1);
+               run_amuck<PthreadMutex>(&a);
+               clock_gettime(CLOCK_MONOTONIC, &t2);
+
+               double ns = ((t2.tv_sec - t1.tv_sec) * 1e9 + (t2.tv_nsec - t1.tv_nsec)) / CROSSOVER_MAX_INNER;
+               if (r == 0 || ns < best)
+                       best = ns;
+       }
+       lock.destroy();
+
+       return best;
+}
+
+/*!
+ * \brief crossover: 固定累加总次数, 在 cpus 上用 threads 个线程, 临界区长度 inner, 取最短耗时(微秒)
+ */
+template <class Lock>
+long crossover_measure(const cpu_set_t *cpus, int threads, int inner)
+{
+       Lock lock;
+       long usec, best = 0;
+       int r;
+
+       //--每个线程至少请求一次锁
+       int loops = CROSSOVER_TOTAL / inner / threads;
+       if (loops < 1)
+               loops = 1;
+
+       lock.init();
+       for (r = 0; r < CROSSOVER_REPEAT; r++) {
+               usec = run_threads(run_amuck<Lock>, &lock, threads, loops, 0, inner, cpus);
+               if (r == 0 || usec < best)
+                       best = usec;
+       }
+       lock.destroy();
+
+       return best;
+}
+
+/*!
+ * \brief crossover: mutex 是否快于 spinlock, 原始样本输出到 stderr
+ */
+static bool mutex_wins(const cpu_set_t *cpus, int cores, int ratio, int threads, int inner)
+{
+       long spin = crossover_measure<PthreadSpinLock>(cpus, threads, inner);
+       long mutex = crossover_measure<PthreadMutex>(cpus, threads, inner);
+
+       fprintf(stderr, "sample cores=%d ratio=%d threads=%d inner=%d spin_us=%ld mutex_us=%ld\n",
+               cores, ratio, threads, inner, spin, mutex);
+
+       return mutex < spin;
+}
+
+/*!
+ * \brief crossover 扫描: 核数 x 超额倍数 x 临界区长度
+ *        对每个(核数, 倍数)先按 2 的幂增大临界区长度, 找到 mutex 开始快于 spinlock 的区间,
+ *        再在区间内二分细化, 输出 CSV 到 stdout:
+ *        cores,ratio,threads,crossover_inner,crossover_ns
+ *        crossover_inner = -1 表示扫描范围内 spinlock 始终更快
+ */
+static void run_crossover()
+{
+       static const int ratios[] = { 1, 2, 4 };
+       cpu_set_t allowed, cpus;
+       int cpu_list[CPU_SETSIZE];
+       int ncpu = 0, cores, r, i;
+       double ns_per_inner;
+
+       //--进程允许运行的 CPU
+       sched_getaffinity(0, sizeof(allowed), &allowed);
+       for (i = 0; i < CPU_SETSIZE; i++) {
+               if (CPU_ISSET(i, &allowed))
+                       cpu_list[ncpu++] = i;
+       }
+
+       ns_per_inner = calibrate_ns_per_inner();
+       fprintf(stderr, "calibrate ns_per_inner=%.3f cpus=%d\n", ns_per_inner, ncpu);
+
+       printf("cores,ratio,threads,crossover_inner,crossover_ns\n");
+
+       //--核数 1 2 4 ... 以及全部核
+       for (cores = 1; ; cores *= 2) {
+               if (cores > ncpu)
+                       cores = ncpu;
+
+               CPU_ZERO(&cpus);
+               for (i = 0; i < cores; i++)
+                       CPU_SET(cpu_list[i], &cpus);
+
+               for (r = 0; r < (int)(sizeof(ratios) / sizeof(ratios[0])); r++) {
+                       int threads = cores * ratios[r];
+                       int lo = 0, hi = -1, inner;
+
+                       //--至少两个线程才有竞争
+                       if (threads < 2 || threads > MAX_THREADS)
+                               continue;
+
+                       //--粗扫: 找到第一个 mutex 更快的长度 hi, lo 为上一个长度
+                       for (inner = 1; inner <= CROSSOVER_MAX_INNER; inner *= 2) {
+                               if (mutex_wins(&cpus, cores, ratios[r], threads, inner)) {
+                                       hi = inner;
+                                       break;
+                               }
+                               lo = inner;
+                       }
+
+                       //--细化: 在 (lo, hi] 内二分
+                       for (i = 0; hi > 0 && i < CROSSOVER_BISECT && hi - lo > 1; i++) {
+                               int mid = lo + (hi - lo) / 2;
+                               if (mutex_wins(&cpus, cores, ratios[r], threads, mid))
+                                       hi = mid;
+                               else
+                                       lo = mid;
+                       }
+
+                       printf("%d,%d,%d,%d,%.1f\n", cores, ratios[r], threads, hi,
+                              hi > 0 ? hi * ns_per_inner : -1.0);
+                       fflush(stdout);
+               }
+
+               if (cores == ncpu)
+                       break;
+       }
+}
+
+/*!
+ * \brief 进程(全部线程)已消耗的 CPU 时间(微秒), 用户态 + 内核态
+ */
+static long cpu_usec()
+{
+       struct rusage ru;
+
+       getrusage(RUSAGE_SELF, &ru);
+       return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000L
+               + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/*!
+ * \brief oversub 模式下运行一种锁策略, 线程数 = 核数 x 2/4/8
+ *        ticket / mcs 按先来先服务交接锁, 超额时每次交接都可能等一个时间片, 需在命令行显式指定
+ */
+template <class Lock>
+void run_oversub_policy(int ncpu, int argc, char *argv[])
+{
+       static const int ratios[] = { 2, 4, 8 };
+       Lock lock;
+       long wall, cpu;
+       int r;
+
+       if (!selected(Lock::name(), g_policy_names, argc, argv))
+               return;
+       if (!named(g_policy_names, argc, argv)
+                       && (strcmp(Lock::name(), "ticket") == 0 || strcmp(Lock::name(), "mcs") == 0))
+               return;
+
+       lock.init();
+       for (r = 0; r < (int)(sizeof(ratios) / sizeof(ratios[0])); r++) {
+               int threads = ncpu * ratios[r];
+               if (threads > MAX_THREADS)
+                       threads = MAX_THREADS;
+
+               //--锁请求总次数固定, 平均分给各线程
+               int loops = OVERSUB_LOCKS / threads;
+               if (loops < 1)
+                       loops = 1;
+
+               run_threads(run_amuck<Lock>, &lock, threads, loops / 100 + 1, 0);
+
+               cpu = cpu_usec();
+               wall = run_threads(run_amuck<Lock>, &lock, threads, loops, 0);
+               cpu = cpu_usec() - cpu;
+
+               printf("%-16s %5dx %7d %5ld.%06ld %5ld.%06ld %8.2f\n", Lock::name(), ratios[r], threads,
+                      wall / 1000000, wall % 1000000, cpu / 1000000, cpu % 1000000,
+                      (double)cpu / wall);
+               fflush(stdout);
+       }
+       lock.destroy();
+}
+
+/*!
+ * \brief oversub 模式: 线程数超过核数时, 持锁线程被抢占, 自旋等待者白白消耗时间片
+ *        打印墙钟时间与 CPU 时间(getrusage), 两者之比即平均占用的核数
+ */
+static void run_oversub(int argc, char *argv[])
+{
+       int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+       g_report_win = 0;
+       printf("oversubscription on %d cpus, %d lock requests per run\n", ncpu, OVERSUB_LOCKS);
+       printf("%-16s %6s %7s %12s %12s %8s\n", "policy", "ratio", "threads", "wall(s)", "cpu(s)", "cpu/wall");
+
+       run_oversub_policy<PthreadSpinLock>(ncpu, argc, argv);
+       run_oversub_policy<PthreadMutex>(ncpu, argc, argv);
+       run_oversub_policy<PthreadAdaptiveMutex>(ncpu, argc, argv);
+       run_oversub_policy<TicketLock>(ncpu, argc, argv);
+       run_oversub_policy<McsLock>(ncpu, argc, argv);
+       run_oversub_policy<SpinYieldLock>(ncpu, argc, argv);
+       run_oversub_policy<SpinParkLock>(ncpu, argc, argv);
+}
+
+int main(int argc, char *argv[])
+{
+       int i;
+       long usec;
+
+       //--crossover 扫描单独运行, stdout 只输出 CSV
+       //--oversub 单独运行
+       for (i = 1; i < argc; i++) {
+               if (strcmp(argv[i], "crossover") == 0) {
+                       run_crossover();
+                       return (0);
+               }
+               if (strcmp(argv[i], "oversub") == 0) {
+                       run_oversub(argc, argv);
+                       return (0);
+               }
+       }
+
+       //--打印线程数量
+       printf("Creating %d threads...\n", THREAD_NUM);
+
+       //--locked: 原始版本, 同一次运行中依次比较各种锁
+       if (selected("locked", g_mode_names, argc, argv)) {
+               run_policy<PthreadSpinLock>(argc, argv);
+               run_policy<PthreadMutex>(argc, argv);
+               run_policy<PthreadAdaptiveMutex>(argc, argv);
+               run_policy<TicketLock>(argc, argv);
+               run_policy<McsLock>(argc, argv);
+               run_policy<SpinYieldLock>(argc, argv);
+               run_policy<SpinParkLock>(argc, argv);
+       }
+
+       //--sharded: 每线程独立计数, 结束后合并
+       if (selected("sharded", g_mode_names, argc, argv)) {
+               printf("==== sharded ====\n");
+               run_threads(run_sharded, NULL, THREAD_NUM, WARMUP_LOOPS, 0);
+               usec = run_threads(run_sharded, NULL, THREAD_NUM, LOCK_LOOPS, 1);
+               merge_shards(THREAD_NUM);
+               add_result("sharded", "-", usec);
+       }
+
+       //--atomic: 每块一次 fetch_add
+       if (selected("atomic", g_mode_names, argc, argv)) {
+               printf("==== atomic ====\n");
+               run_threads(run_atomic, NULL, THREAD_NUM, WARMUP_LOOPS, 0);
+               usec = run_threads(run_atomic, NULL, THREAD_NUM, LOCK_LOOPS, 1);
+               g_count = g_atomic_count.load();
+               add_result("atomic", "-", usec);
+       }
+
+       //--并列打印各模式耗时
+       printf("\n%-8s %-16s %12s %12s\n", "mode", "policy", "seconds", "count");
+       for (i = 0; i < g_result_num; i++) {
+               printf("%-8s %-16s %5ld.%06ld %12llu\n", g_result[i].mode, g_result[i].policy,
+                      g_result[i].usec / 1000000, g_result[i].usec % 1000000,
+                      (unsigned long long)g_result[i].count);
+       }
+
+       //--锁公平性: 等待/持锁时间直方图, 连续重入
+       for (i = 0; i < g_result_num; i++) {
+               if (g_result[i].has_stats)
+                       print_fairness(&g_result[i]);
+       }
+
+       printf("Done.\n");
+
+       return (0);
+}
@@ -2,19 +2,21 @@ TEMPLATE = app
 CONFIG += console
 CONFIG -= app_bundle
 CONFIG -= qt
+CONFIG += c++17
 
 SOURCES += \
-        main.c
+        main.cc
+
+HEADERS += \
+        ../common/lockpolicy.h
+
+INCLUDEPATH += ../common
 
 unix:!macx: LIBS += -lpthread
 
 
 #message(COMPILE)
-#system( gcc -o spin -DUSE_SPINLOCK $$SOURCES -lpthread)
-#system( gcc -o mutex $$SOURCES -lpthread)
-
-#message(RUN mutex)
-#system(time ./mutex)
+#system( g++ -O2 -std=c++17 -I../common -o spinlockvsmutex2 $$SOURCES -lpthread)
 
-#message(RUN spin)
-#system(time ./spin)
+#message(RUN all lock policies)
+#system(time ./spinlockvsmutex2)